@@ -0,0 +1,412 @@
+#include "leptdtoa.h"
+#include <assert.h>  /* assert() */
+#include <stdio.h>   /* snprintf() */
+#include <stdlib.h>  /* strtod(), strtol() */
+#include <string.h>  /* memcpy() */
+
+/*
+ * Grisu3, after Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers" (PLDI 2010). It either produces the shortest digits
+ * that read back as the same double (the closest ones if there are several), or
+ * reports that 64-bit arithmetic cannot tell. The latter happens for about 0.5%
+ * of inputs; those go through an exact but slower search built on printf/strtod.
+ */
+
+static const char lept_digits_lut[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+static const uint64_t lept_pow10[20] = {
+    UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+    UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+    UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+    UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+    UINT64_C(1000000000000000), UINT64_C(10000000000000000),
+    UINT64_C(100000000000000000), UINT64_C(1000000000000000000),
+    UINT64_C(10000000000000000000)
+};
+
+/* 10^k for k = -348, -340, ..., 340, normalized to 64 bits: f * 2^e */
+static const uint64_t lept_cached_f[87] = {
+    UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76), UINT64_C(0xcf42894a5dce35ea),
+    UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df), UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f),
+    UINT64_C(0xbe5691ef416bd60c), UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+    UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57), UINT64_C(0xc21094364dfb5637),
+    UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7), UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5),
+    UINT64_C(0xb23867fb2a35b28e), UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+    UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126), UINT64_C(0xb5b5ada8aaff80b8),
+    UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053), UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd),
+    UINT64_C(0xa6dfbd9fb8e5b88f), UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+    UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06), UINT64_C(0xaa242499697392d3),
+    UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb), UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c),
+    UINT64_C(0x9c40000000000000), UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+    UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068), UINT64_C(0x9f4f2726179a2245),
+    UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8), UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a),
+    UINT64_C(0x924d692ca61be758), UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+    UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d), UINT64_C(0x952ab45cfa97a0b3),
+    UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25), UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece),
+    UINT64_C(0x88fcf317f22241e2), UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+    UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410), UINT64_C(0x8bab8eefb6409c1a),
+    UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129), UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429),
+    UINT64_C(0x80444b5e7aa7cf85), UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+    UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b)
+};
+static const short lept_cached_e[87] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+#define LEPT_DP_SIGNIFICAND_MASK UINT64_C(0x000FFFFFFFFFFFFF)
+#define LEPT_DP_HIDDEN_BIT       UINT64_C(0x0010000000000000)
+#define LEPT_DP_EXPONENT_BIAS    1075  /* 0x3FF + 52 */
+
+/* f * 2^e */
+typedef struct {
+    uint64_t f;
+    int e;
+} lept_diy_fp;
+
+static lept_diy_fp lept_diy_fp_make( uint64_t f, int e ) {
+    lept_diy_fp r;
+    r.f = f;
+    r.e = e;
+    return r;
+}
+
+static lept_diy_fp lept_diy_fp_normalize( lept_diy_fp v ) {
+    while ( !( v.f & ( UINT64_C(1) << 63 ) ) ) {
+        v.f <<= 1;
+        v.e--;
+    }
+    return v;
+}
+
+/* upper 64 bits of the 128-bit product, rounded */
+static lept_diy_fp lept_diy_fp_multiply( lept_diy_fp x, lept_diy_fp y ) {
+    const uint64_t m32 = 0xFFFFFFFFu;
+    uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = ( bd >> 32 ) + ( ad & m32 ) + ( bc & m32 );
+    tmp += 1u << 31;
+    return lept_diy_fp_make( ac + ( ad >> 32 ) + ( bc >> 32 ) + ( tmp >> 32 ), x.e + y.e + 64 );
+}
+
+/* the midpoints to the neighbouring doubles, both with the exponent of *plus */
+static void lept_normalized_boundaries( lept_diy_fp v, lept_diy_fp *minus, lept_diy_fp *plus ) {
+    lept_diy_fp pl = lept_diy_fp_make( ( v.f << 1 ) + 1, v.e - 1 ), mi;
+    while ( !( pl.f & ( LEPT_DP_HIDDEN_BIT << 1 ) ) ) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 10;  /* 64 - 52 - 2 */
+    pl.e -= 10;
+    /* the lower neighbour is closer when v is a power of two */
+    if ( v.f == LEPT_DP_HIDDEN_BIT )
+        mi = lept_diy_fp_make( ( v.f << 2 ) - 1, v.e - 2 );
+    else
+        mi = lept_diy_fp_make( ( v.f << 1 ) - 1, v.e - 1 );
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    *minus = mi;
+    *plus = pl;
+}
+
+/* a cached power c = 10^-k such that e + c.e + 64 lands in [-60, -32] */
+static lept_diy_fp lept_cached_power( int e, int *k ) {
+    double dk = ( -61 - e ) * 0.30102999566398114 + 347;
+    int ik = ( int )dk, index;
+    if ( dk - ik > 0.0 )
+        ik++;
+    index = ( ik >> 3 ) + 1;
+    *k = -( -348 + index * 8 );
+    return lept_diy_fp_make( lept_cached_f[index], lept_cached_e[index] );
+}
+
+static int lept_count_decimal_digits( uint32_t n ) {
+    int count = 1;
+    while ( count < 10 && n >= lept_pow10[count] )
+        count++;
+    return count;
+}
+
+/*
+ * Move the last digit towards w while staying inside the interval, then check that
+ * the result is provably the closest and inside the real (not widened) interval.
+ * All quantities are relative to too_high and carry an error of +-unit.
+ */
+static int lept_round_weed( char *buffer, int len, uint64_t distance_too_high_w, uint64_t unsafe_interval,
+                            uint64_t rest, uint64_t ten_kappa, uint64_t unit ) {
+    uint64_t small_distance = distance_too_high_w - unit;
+    uint64_t big_distance = distance_too_high_w + unit;
+    while ( rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+            ( rest + ten_kappa < small_distance ||
+              small_distance - rest >= rest + ten_kappa - small_distance ) ) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+    /* another candidate could be closer to w: undecidable */
+    if ( rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+         ( rest + ten_kappa < big_distance ||
+           big_distance - rest > rest + ten_kappa - big_distance ) )
+        return 0;
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+/*
+ * low, w and high are the scaled boundaries and value, all with the same exponent
+ * in [-60, -32]. Generates digits of too_high until the rest falls inside the
+ * widened interval; *kappa is the decimal exponent of the last digit.
+ */
+static int lept_digit_gen( lept_diy_fp low, lept_diy_fp w, lept_diy_fp high, char *buffer, int *len, int *kappa ) {
+    uint64_t unit = 1;
+    uint64_t too_low = low.f - unit, too_high = high.f + unit;
+    uint64_t unsafe_interval = too_high - too_low;
+    lept_diy_fp one = lept_diy_fp_make( UINT64_C(1) << -w.e, w.e );
+    uint32_t integrals = ( uint32_t )( too_high >> -one.e );
+    uint64_t fractionals = too_high & ( one.f - 1 );
+    *kappa = lept_count_decimal_digits( integrals );
+    *len = 0;
+
+    /* integer part */
+    while ( *kappa > 0 ) {
+        uint32_t divisor = ( uint32_t )lept_pow10[*kappa - 1];
+        uint64_t rest;
+        buffer[( *len )++] = ( char )( '0' + integrals / divisor );
+        integrals %= divisor;
+        ( *kappa )--;
+        rest = ( ( uint64_t )integrals << -one.e ) + fractionals;
+        if ( rest < unsafe_interval )
+            return lept_round_weed( buffer, *len, too_high - w.f, unsafe_interval, rest,
+                                    ( uint64_t )divisor << -one.e, unit );
+    }
+
+    /* fractional part */
+    for ( ;; ) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        buffer[( *len )++] = ( char )( '0' + ( fractionals >> -one.e ) );
+        fractionals &= one.f - 1;
+        ( *kappa )--;
+        if ( fractionals < unsafe_interval )
+            return lept_round_weed( buffer, *len, ( too_high - w.f ) * unit, unsafe_interval, fractionals,
+                                    one.f, unit );
+    }
+}
+
+/* value = digits * 10^k, value > 0; returns 0 when the digits cannot be decided */
+static int lept_grisu3( double value, char *digits, int *len, int *k ) {
+    uint64_t bits, significand;
+    int biased_e, kappa;
+    lept_diy_fp v, w_m, w_p, c_mk;
+    memcpy( &bits, &value, sizeof( bits ) );
+    biased_e = ( int )( ( bits >> 52 ) & 0x7FF );
+    significand = bits & LEPT_DP_SIGNIFICAND_MASK;
+    if ( biased_e != 0 )
+        v = lept_diy_fp_make( significand + LEPT_DP_HIDDEN_BIT, biased_e - LEPT_DP_EXPONENT_BIAS );
+    else
+        v = lept_diy_fp_make( significand, 1 - LEPT_DP_EXPONENT_BIAS );
+
+    lept_normalized_boundaries( v, &w_m, &w_p );
+    c_mk = lept_cached_power( w_p.e, k );
+    if ( !lept_digit_gen( lept_diy_fp_multiply( w_m, c_mk ), lept_diy_fp_multiply( lept_diy_fp_normalize( v ), c_mk ),
+                          lept_diy_fp_multiply( w_p, c_mk ), digits, len, &kappa ) )
+        return 0;
+    *k += kappa;
+    return 1;
+}
+
+/* writes digits "e" exp10 and checks that strtod reads it back as value */
+static int lept_reads_back( const char *digits, int len, int exp10, double value ) {
+    char text[40];
+    memcpy( text, digits, len );
+    snprintf( text + len, sizeof( text ) - len, "e%d", exp10 );
+    return strtod( text, NULL ) == value;
+}
+
+/*
+ * Tries the two len-digit decimals next to value: printf's correctly rounded one,
+ * then the one on the other side, which can be the only one inside the interval
+ * when value is a power of two.
+ */
+static int lept_try_length( double value, int len, char *digits, int *k ) {
+    char text[40];
+    const char *p = text;
+    int n = 0, i, exp10;
+    double nearest;
+    snprintf( text, sizeof( text ), "%.*e", len - 1, value );
+    for ( ; *p != 'e'; p++ )
+        if ( *p >= '0' && *p <= '9' )
+            digits[n++] = *p;
+    exp10 = ( int )strtol( p + 1, NULL, 10 ) - len + 1;
+    if ( lept_reads_back( digits, len, exp10, value ) ) {
+        *k = exp10;
+        return 1;
+    }
+    nearest = strtod( text, NULL );
+    if ( nearest < value ) {
+        for ( i = len - 1; i >= 0 && digits[i] == '9'; i-- )
+            digits[i] = '0';
+        if ( i < 0 ) {
+            digits[0] = '1';
+            exp10++;
+        }
+        else
+            digits[i]++;
+    }
+    else {
+        for ( i = len - 1; i >= 0 && digits[i] == '0'; i-- )
+            digits[i] = '9';
+        if ( i == 0 && digits[0] == '1' ) {
+            /* 1000 -> 9999 one decade lower */
+            digits[0] = '9';
+            exp10--;
+        }
+        else
+            digits[i]--;
+    }
+    if ( !lept_reads_back( digits, len, exp10, value ) )
+        return 0;
+    *k = exp10;
+    return 1;
+}
+
+/*
+ * The exact fallback. Some len-digit decimal reads back as value if and only if
+ * one of the two next to it does, and that holds for every longer length too,
+ * so a binary search over 1..17 finds the shortest length.
+ */
+static void lept_shortest_exact( double value, char *digits, int *len, int *k ) {
+    char candidate[20];
+    int lo = 1, hi = 17, candidate_k;
+    while ( lo < hi ) {
+        int mid = ( lo + hi ) / 2;
+        if ( lept_try_length( value, mid, candidate, &candidate_k ) )
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    lept_try_length( value, lo, digits, k );
+    *len = lo;
+    while ( *len > 1 && digits[*len - 1] == '0' ) {
+        ( *len )--;
+        ( *k )++;
+    }
+}
+
+static char *lept_write_exponent( int e, char *p ) {
+    *p++ = 'e';
+    if ( e < 0 ) {
+        *p++ = '-';
+        e = -e;
+    }
+    else
+        *p++ = '+';
+    if ( e >= 100 ) {
+        *p++ = ( char )( '0' + e / 100 );
+        e %= 100;
+    }
+    memcpy( p, lept_digits_lut + e * 2, 2 );
+    return p + 2;
+}
+
+char *lept_dtoa( double value, char *buffer ) {
+    char digits[24];
+    int len, k, exp10;
+    char *p = buffer;
+    assert( value - value == 0.0 && "value must be finite" );
+    if ( value < 0 || ( value == 0 && 1 / value < 0 ) ) {
+        *p++ = '-';
+        value = -value;
+    }
+    if ( value == 0 ) {
+        *p++ = '0';
+        return p;
+    }
+    /*
+     * below 2^53 every integer is a double and no other decimal is within half a
+     * unit, so its own digits are the shortest; above that e.g. 72057594037927952
+     * reads back from 7.205759403792795e+16
+     */
+    if ( value < 9007199254740992.0 && value == ( double )( uint64_t )value )
+        return lept_u64toa( ( uint64_t )value, p );
+
+    if ( !lept_grisu3( value, digits, &len, &k ) )
+        lept_shortest_exact( value, digits, &len, &k );
+    exp10 = len + k - 1;  /* 10^exp10 <= value < 10^(exp10 + 1) */
+    if ( exp10 >= 0 && exp10 < 17 ) {
+        if ( len <= exp10 + 1 ) {
+            /* 1234e2 -> 123400 */
+            memcpy( p, digits, len );
+            memset( p + len, '0', exp10 + 1 - len );
+            return p + exp10 + 1;
+        }
+        /* 1234e-2 -> 12.34 */
+        memcpy( p, digits, exp10 + 1 );
+        p[exp10 + 1] = '.';
+        memcpy( p + exp10 + 2, digits + exp10 + 1, len - exp10 - 1 );
+        return p + len + 1;
+    }
+    if ( exp10 < 0 && exp10 >= -4 ) {
+        /* 1234e-6 -> 0.001234 */
+        p[0] = '0';
+        p[1] = '.';
+        memset( p + 2, '0', -exp10 - 1 );
+        memcpy( p + 1 - exp10, digits, len );
+        return p + 1 - exp10 + len;
+    }
+    /* 1234e30 -> 1.234e+33 */
+    *p++ = digits[0];
+    if ( len > 1 ) {
+        *p++ = '.';
+        memcpy( p, digits + 1, len - 1 );
+        p += len - 1;
+    }
+    return lept_write_exponent( exp10, p );
+}
+
+char *lept_u64toa( uint64_t value, char *buffer ) {
+    char temp[20];
+    char *p = temp + sizeof( temp );
+    size_t len;
+    while ( value >= 100 ) {
+        const char *d = lept_digits_lut + ( value % 100 ) * 2;
+        value /= 100;
+        *--p = d[1];
+        *--p = d[0];
+    }
+    if ( value < 10 )
+        *--p = ( char )( '0' + value );
+    else {
+        *--p = lept_digits_lut[value * 2 + 1];
+        *--p = lept_digits_lut[value * 2];
+    }
+    len = ( size_t )( temp + sizeof( temp ) - p );
+    memcpy( buffer, p, len );
+    return buffer + len;
+}
+
+char *lept_i64toa( int64_t value, char *buffer ) {
+    uint64_t u = ( uint64_t )value;
+    if ( value < 0 ) {
+        *buffer++ = '-';
+        u = ~u + 1;
+    }
+    return lept_u64toa( u, buffer );
+}
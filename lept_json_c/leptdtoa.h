@@ -0,0 +1,29 @@
+#ifndef LEPTDTOA_H__
+#define LEPTDTOA_H__
+
+#include <stdint.h> /* int64_t, uint64_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* enough for any output of the functions below, including a trailing '\0' */
+#define LEPT_DTOA_BUFFER_SIZE 25
+
+/*
+ * Write the shortest digits that read back as exactly the same double, the closest
+ * ones if there are several (Grisu3 with an exact fallback), laid out like
+ * printf("%.17g"): "0.1", "-0", "1e+20", "5e-324".
+ * value must be finite. No '\0' is written; returns the end of the output.
+ */
+char* lept_dtoa(double value, char* buffer);
+
+/* Integers, two digits at a time from a lookup table. */
+char* lept_u64toa(uint64_t value, char* buffer);
+char* lept_i64toa(int64_t value, char* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LEPTDTOA_H__ */
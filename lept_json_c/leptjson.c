@@ -3,10 +3,10 @@
 #include <crtdbg.h>
 #endif
 #include "leptjson.h"
+#include "leptdtoa.h"
 #include <assert.h>  /* assert() */
 #include <errno.h>   /* errno, ERANGE */
 #include <math.h>    /* HUGE_VAL */
-#include <stdio.h>   /* sprintf() */
 #include <stdlib.h>  /* NULL, malloc(), realloc(), free(), strtod() */
 #include <string.h>  /* memcpy() */
 
@@ -366,10 +366,39 @@ int lept_parse( lept_value *v, const char *json ) {
 }
 
 static void lept_stringify_string( lept_context *c, const char *s, size_t len ) {
-    /* ... */
+    static const char hex_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+    size_t i, size;
+    char *head, *p;
+    assert( s != NULL );
+    /* each byte takes at most 6 bytes ("\u00XX"), plus the two quotes */
+    p = head = lept_context_push( c, size = len * 6 + 2 );
+    *p++ = '"';
+    for ( i = 0; i < len; i++ ) {
+        unsigned char ch = ( unsigned char )s[i];
+        switch ( ch ) {
+        case '\"': *p++ = '\\'; *p++ = '\"';  break;
+        case '\\': *p++ = '\\'; *p++ = '\\'; break;
+        case '\b': *p++ = '\\'; *p++ = 'b';  break;
+        case '\f': *p++ = '\\'; *p++ = 'f';  break;
+        case '\n': *p++ = '\\'; *p++ = 'n';  break;
+        case '\r': *p++ = '\\'; *p++ = 'r';  break;
+        case '\t': *p++ = '\\'; *p++ = 't';  break;
+        default:
+            if ( ch < 0x20 ) {
+                *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
+                *p++ = hex_digits[ch >> 4];
+                *p++ = hex_digits[ch & 15];
+            }
+            else
+                *p++ = s[i];
+        }
+    }
+    *p++ = '"';
+    c->top -= size - ( p - head );
 }
 
 static void lept_stringify_value( lept_context *c, const lept_value *v ) {
+    size_t i;
     switch ( v->type ) {
     case LEPT_NULL:
         PUTS( c, "null",  4 );
@@ -381,16 +410,33 @@ static void lept_stringify_value( lept_context *c, const lept_value *v ) {
         PUTS( c, "true",  4 );
         break;
     case LEPT_NUMBER:
-        c->top -= 32 - sprintf( lept_context_push( c, 32 ), "%.17g", v->u.n );
+        {
+            char *buffer = lept_context_push( c, LEPT_DTOA_BUFFER_SIZE );
+            c->top -= LEPT_DTOA_BUFFER_SIZE - ( size_t )( lept_dtoa( v->u.n, buffer ) - buffer );
+        }
         break;
     case LEPT_STRING:
         lept_stringify_string( c, v->u.s.s, v->u.s.len );
         break;
     case LEPT_ARRAY:
-        /* ... */
+        PUTC( c, '[' );
+        for ( i = 0; i < v->u.a.size; i++ ) {
+            if ( i > 0 )
+                PUTC( c, ',' );
+            lept_stringify_value( c, &v->u.a.e[i] );
+        }
+        PUTC( c, ']' );
         break;
     case LEPT_OBJECT:
-        /* ... */
+        PUTC( c, '{' );
+        for ( i = 0; i < v->u.o.size; i++ ) {
+            if ( i > 0 )
+                PUTC( c, ',' );
+            lept_stringify_string( c, v->u.o.m[i].k, v->u.o.m[i].klen );
+            PUTC( c, ':' );
+            lept_stringify_value( c, &v->u.o.m[i].v );
+        }
+        PUTC( c, '}' );
         break;
     default:
         assert( 0 && "invalid type" );
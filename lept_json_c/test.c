@@ -395,14 +395,27 @@ static void test_stringify_number() {
     TEST_ROUNDTRIP("1.234e-20");
 
     TEST_ROUNDTRIP("1.0000000000000002"); /* the smallest number > 1 */
-    TEST_ROUNDTRIP("4.9406564584124654e-324"); /* minimum denormal */
-    TEST_ROUNDTRIP("-4.9406564584124654e-324");
-    TEST_ROUNDTRIP("2.2250738585072009e-308");  /* Max subnormal double */
-    TEST_ROUNDTRIP("-2.2250738585072009e-308");
+    TEST_ROUNDTRIP("5e-324"); /* minimum denormal */
+    TEST_ROUNDTRIP("-5e-324");
+    TEST_ROUNDTRIP("2.225073858507201e-308");  /* Max subnormal double */
+    TEST_ROUNDTRIP("-2.225073858507201e-308");
     TEST_ROUNDTRIP("2.2250738585072014e-308");  /* Min normal positive double */
     TEST_ROUNDTRIP("-2.2250738585072014e-308");
     TEST_ROUNDTRIP("1.7976931348623157e+308");  /* Max double */
     TEST_ROUNDTRIP("-1.7976931348623157e+308");
+    /* shortest digits that read back as the same double */
+    TEST_ROUNDTRIP("0.1");
+    TEST_ROUNDTRIP("0.3");
+    TEST_ROUNDTRIP("0.0001");
+    TEST_ROUNDTRIP("1e-05");
+    TEST_ROUNDTRIP("123456.789");
+    TEST_ROUNDTRIP("10000000000000000");
+    TEST_ROUNDTRIP("1e+17");
+    TEST_ROUNDTRIP("1.2345678901234568e+17");
+    /* Grisu2 wrote 93442.63219999999 and 56976.302937809996 for these */
+    TEST_ROUNDTRIP("93442.6322");
+    TEST_ROUNDTRIP("56976.30293781");
+    TEST_ROUNDTRIP("72057594037927950"); /* 2^56 + 16, above 2^53 */
 }
 
 static void test_stringify_string() {
@@ -0,0 +1,51 @@
+#include "JsonArena.hh"
+
+#include <new>
+
+namespace {
+// 单个块最大只翻倍到这么大，避免大文档一次申请过多
+constexpr size_t kMaxBlockSize = 4 * 1024 * 1024;
+}  // namespace
+
+void *JsonArena::allocate_slow(size_t bytes, size_t alignment) {
+  size_t need = sizeof(Block) + bytes + alignment;
+  size_t size = block_size_ < need ? need : block_size_;
+  if (block_size_ < kMaxBlockSize) block_size_ *= 2;
+
+  auto *block = static_cast<Block *>(::operator new(size));
+  block->next = head_;
+  block->size = size;
+  head_ = block;
+  bytes_reserved_ += size;
+
+  cur_ = reinterpret_cast<char *>(block + 1);
+  end_ = reinterpret_cast<char *>(block) + size;
+  return do_allocate(bytes, alignment);
+}
+
+void JsonArena::reset() {
+  if (head_ == nullptr) return;
+  // 超过block_size_的分配会单独申请一块，最大的不一定是最后申请的
+  Block **link = &head_;
+  for (Block **curr = &head_->next; *curr != nullptr; curr = &(*curr)->next) {
+    if ((*curr)->size > (*link)->size) link = curr;
+  }
+  Block *keep = *link;
+  *link = keep->next;
+  release();
+  keep->next = nullptr;
+  head_ = keep;
+  bytes_reserved_ = keep->size;
+  cur_ = reinterpret_cast<char *>(keep + 1);
+  end_ = reinterpret_cast<char *>(keep) + keep->size;
+}
+
+void JsonArena::release() {
+  while (head_ != nullptr) {
+    Block *next = head_->next;
+    ::operator delete(head_);
+    head_ = next;
+  }
+  cur_ = end_ = nullptr;
+  bytes_used_ = bytes_reserved_ = 0;
+}
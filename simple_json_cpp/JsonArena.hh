@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// bump分配器：按块向系统申请内存，分配只是移动指针，
+// deallocate什么都不做，所有内存在release()或析构时一次性归还
+class JsonArena : public std::pmr::memory_resource {
+ public:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit JsonArena(size_t block_size = kDefaultBlockSize)
+      : block_size_(block_size < kMinBlockSize ? kMinBlockSize : block_size) {}
+  JsonArena(const JsonArena &) = delete;
+  void operator=(const JsonArena &) = delete;
+  ~JsonArena() override { release(); }
+
+  // 归还所有块，之前分配出去的指针全部失效
+  void release();
+  // 和release一样丢掉所有分配，但留下最大的一块给下次用
+  void reset();
+
+  // 分配给调用者的字节数
+  [[nodiscard]] size_t bytes_used() const { return bytes_used_; }
+  // 向系统申请的字节数
+  [[nodiscard]] size_t bytes_reserved() const { return bytes_reserved_; }
+
+ private:
+  static constexpr size_t kMinBlockSize = 256;
+
+  struct Block {
+    Block *next;
+    size_t size;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    auto cur = reinterpret_cast<uintptr_t>(cur_);
+    uintptr_t aligned = (cur + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (cur_ == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(end_))
+      return allocate_slow(bytes, alignment);
+    cur_ = reinterpret_cast<char *>(aligned + bytes);
+    bytes_used_ += bytes;
+    return reinterpret_cast<void *>(aligned);
+  }
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  void *allocate_slow(size_t bytes, size_t alignment);
+
+  Block *head_{nullptr};
+  char *cur_{nullptr};
+  char *end_{nullptr};
+  size_t block_size_;
+  size_t bytes_used_{0};
+  size_t bytes_reserved_{0};
+};
@@ -0,0 +1,83 @@
+#include "JsonBatch.hh"
+#include "JsonParallel.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// 分片太小时线程的开销比解析还大
+constexpr size_t kMinShardSize = 4 * 1024;
+
+inline bool is_blank(std::string_view line) {
+  for (char c : line) {
+    if (c != ' ' && c != '\t' && c != '\r') return false;
+  }
+  return true;
+}
+}  // namespace
+
+// 先按字节数把输入切成若干分片，边界挪到下一个换行之后，
+// 各个线程领取分片，分片之内再按行切开逐行解析
+// 合法的JSON文本里换行不会出现在字符串里，所以每个换行都是记录的边界，
+// 分片和切行都不需要从头扫描引号的状态，可以完全并行
+size_t JsonParser::parse_many(std::string_view input, JsonBatch &batch,
+                              size_t threads) {
+  batch.clear();
+  threads = JsonParallel::thread_count(threads);
+  // 分片比线程多几倍，行长短不一时各个线程的负载也比较均匀
+  size_t shard_count = threads == 1 ? 1 : threads * 4;
+  shard_count = std::max<size_t>(
+      1, std::min(shard_count, input.size() / kMinShardSize));
+
+  std::vector<size_t> bounds{0};
+  for (size_t i = 1; i < shard_count; i++) {
+    size_t target = std::max(input.size() * i / shard_count, bounds.back());
+    const void *newline =
+        memchr(input.data() + target, '\n', input.size() - target);
+    if (newline == nullptr) break;
+    size_t bound = static_cast<const char *>(newline) - input.data() + 1;
+    if (bound != bounds.back()) bounds.push_back(bound);
+  }
+  if (bounds.back() != input.size()) bounds.push_back(input.size());
+  size_t shards = bounds.size() - 1;
+
+  std::vector<std::vector<JsonBatch::Record>> records(shards);
+  for (size_t i = 0; i < shards; i++)
+    batch.arenas_.push_back(std::make_unique<JsonArena>());
+  // 逐行解析一个分片，每个分片用自己的JsonParser，各个线程互不影响
+  size_t max_depth = JsonParse::max_depth();
+  JsonKeyPool *key_pool = JsonParse::key_pool();
+  bool validate_utf8 = JsonParse::validate_utf8();
+  auto parse_shard = [&](size_t i) {
+    JsonParser parser;
+    parser.set_max_depth(max_depth);
+    parser.set_key_pool(key_pool);
+    parser.set_validate_utf8(validate_utf8);
+    const char *p = input.data() + bounds[i];
+    const char *end = input.data() + bounds[i + 1];
+    while (p != end) {
+      auto *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+      const char *line_end = newline != nullptr ? newline : end;
+      std::string_view line(p, line_end - p);
+      p = newline != nullptr ? newline + 1 : end;
+      if (is_blank(line)) continue;
+      parser.reset_context(line.data(), line.size(), batch.arenas_[i].get());
+      auto &record = records[i].emplace_back();
+      record.json = line;
+      record.error = parser.parse_root(record.value);
+    }
+  };
+  JsonParallel::for_each(shards, threads, parse_shard);
+
+  size_t total = 0;
+  for (auto &shard : records) total += shard.size();
+  batch.records_.reserve(total);
+  size_t errors = 0;
+  for (auto &shard : records) {
+    for (auto &record : shard) {
+      errors += record.error != JSON_PARSE_OK;
+      batch.records_.push_back(std::move(record));
+    }
+  }
+  return errors;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "JsonParse.hh"
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// JsonParse::parse_many的结果：NDJSON(JSON Lines)里每个非空行是一条记录
+//   JsonBatch batch;
+//   JsonParse::parse_many(ndjson, batch);
+//   for (auto &record : batch)
+//     if (record.error == JSON_PARSE_OK) use(record.value);
+// 记录按输入的顺序排列，某一行出错只影响这一行
+// 同一个分片的记录分配在同一个arena里，clear或析构时整块归还
+class JsonBatch {
+  friend JsonParser;
+
+ public:
+  struct Record {
+    std::string_view json;  // 这一行的原文，不含换行
+    JsonType value;
+    JParseError error{JSON_PARSE_OK};
+  };
+  using iterator = std::vector<Record>::iterator;
+
+  JsonBatch() = default;
+  JsonBatch(const JsonBatch &) = delete;
+  void operator=(const JsonBatch &) = delete;
+  ~JsonBatch() { clear(); }
+
+  iterator begin() { return records_.begin(); }
+  iterator end() { return records_.end(); }
+  Record &operator[](size_t index) { return records_[index]; }
+  [[nodiscard]] size_t size() const { return records_.size(); }
+
+  // 丢掉所有记录，树里的值全部由arena回收，不需要调用析构
+  void clear() {
+    for (auto &record : records_) record.value.detach();
+    records_.clear();
+    arenas_.clear();
+  }
+
+ private:
+  std::vector<Record> records_;
+  std::vector<std::unique_ptr<JsonArena>> arenas_;
+};
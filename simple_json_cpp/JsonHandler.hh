@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// JsonParse::parse(str, handler)的事件接口(SAX)
+// 解析器按文档顺序调用handler，不构造任何JsonType：
+//   null() boolean(b)
+//   number(d) int64(i) uint64(u)    数字按JsonNumber::parse选出的类型回调
+//   string(str)
+//   start_object() key(str) ... end_object(member_count)
+//   start_array() ... end_array(element_count)
+// 任何一个回调返回false都会中止解析，parse返回JSON_PARSE_TERMINATED
+// string和key的参数只在回调期间有效，需要保留时要自己拷贝
+// handler是模板参数，回调在编译期就确定了，可以被内联
+//
+// 继承JsonBaseHandler只需要实现关心的事件，其它事件直接忽略，整数转成number
+template <typename Derived>
+class JsonBaseHandler {
+ public:
+  bool null() { return true; }
+  bool boolean(bool) { return true; }
+  bool number(double) { return true; }
+  bool int64(int64_t i) { return derived().number(static_cast<double>(i)); }
+  bool uint64(uint64_t u) { return derived().number(static_cast<double>(u)); }
+  bool string(std::string_view) { return true; }
+  bool start_object() { return true; }
+  bool key(std::string_view) { return true; }
+  bool end_object(size_t) { return true; }
+  bool start_array() { return true; }
+  bool end_array(size_t) { return true; }
+
+ private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+};
@@ -0,0 +1,41 @@
+#include "JsonKeyPool.hh"
+
+#include <cstring>
+#include <mutex>
+
+std::string_view JsonKeyPool::intern(std::string_view str, size_t hash) {
+  // 低位留给unordered_set选桶，分片用高位
+  Shard &shard = shards_[(hash >> 16) % kShards];
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.keys.find(str);
+    if (it != shard.keys.end()) return *it;
+  }
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  // 拿到写锁之前可能已经被别的线程插入了
+  auto it = shard.keys.find(str);
+  if (it != shard.keys.end()) return *it;
+  // 空key也给一个池里的地址，保证相同的key地址相同
+  auto *data = static_cast<char *>(shard.arena.allocate(str.size() + 1, 1));
+  memcpy(data, str.data(), str.size());
+  data[str.size()] = '\0';
+  return *shard.keys.emplace(data, str.size()).first;
+}
+
+size_t JsonKeyPool::size() const {
+  size_t total = 0;
+  for (auto &shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    total += shard.keys.size();
+  }
+  return total;
+}
+
+size_t JsonKeyPool::bytes_reserved() const {
+  size_t total = 0;
+  for (auto &shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    total += shard.arena.bytes_reserved();
+  }
+  return total;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "JsonArena.hh"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_set>
+
+// 跨文档共享的key池：同一个key只存一份，文档里的key只是指向池的view
+//   JsonKeyPool pool;
+//   JsonParser parser;
+//   parser.set_key_pool(&pool);
+// 相同的key地址相同，按key查找成员时先比地址(JsonParse.cc的key_equals)，
+// 查找用的key也从池里intern出来就不用比内容；key很多的文档也不再为每个key分配内存
+// 可以被多个线程同时使用，池必须比用它解析出来的文档活得久
+// 池只增不减，适合key集合固定的场景(比如按schema生成的消息)
+class JsonKeyPool {
+ public:
+  JsonKeyPool() = default;
+  JsonKeyPool(const JsonKeyPool &) = delete;
+  void operator=(const JsonKeyPool &) = delete;
+
+  // 返回池里与str相同的那一份，第一次出现时拷贝进池
+  std::string_view intern(std::string_view str) {
+    return intern(str, std::hash<std::string_view>()(str));
+  }
+  // hash必须是std::hash<std::string_view>()(str)，调用者已经算过时省掉一次
+  std::string_view intern(std::string_view str, size_t hash);
+
+  // 不同key的个数
+  [[nodiscard]] size_t size() const;
+  // 存放key向系统申请的字节数
+  [[nodiscard]] size_t bytes_reserved() const;
+
+ private:
+  // 按hash分片，每片一把读写锁，已有的key只需要读锁
+  static constexpr size_t kShards = 16;
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_set<std::string_view> keys;
+    JsonArena arena{4096};
+  };
+  std::array<Shard, kShards> shards_;
+};
@@ -0,0 +1,338 @@
+#include "JsonNumber.hh"
+
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace {
+// double的格式参数
+constexpr int kMantissaExplicitBits = 52;
+constexpr int kMinimumExponent = -1023;
+constexpr int kInfinitePower = 0x7FF;
+// 只有这个范围内的10^q乘出来可能恰好落在两个double正中间
+constexpr int kMinExponentRoundToEven = -4;
+constexpr int kMaxExponentRoundToEven = 23;
+
+constexpr double kExactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 uint128_t;
+#endif
+
+// 64位乘64位得到128位
+inline void full_multiplication(uint64_t a, uint64_t b, uint64_t &high,
+                                uint64_t &low) {
+#if defined(__SIZEOF_INT128__)
+  uint128_t r = static_cast<uint128_t>(a) * b;
+  high = static_cast<uint64_t>(r >> 64);
+  low = static_cast<uint64_t>(r);
+#else
+  uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+  uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+  uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+  uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+  high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+  low = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+}
+
+inline int leading_zeros(uint64_t bits) {
+#if defined(__GNUC__)
+  return __builtin_clzll(bits);
+#else
+  int n = 0;
+  while ((bits & (uint64_t(1) << 63)) == 0) {
+    bits <<= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+// floor(log2(10^q)) + 63
+inline int32_t binary_power(int32_t q) {
+  return (((152170 + 65536) * q) >> 16) + 63;
+}
+
+inline double to_double(bool negative, uint64_t mantissa, int32_t power2) {
+  uint64_t bits = mantissa | (uint64_t(power2) << kMantissaExplicitBits) |
+                  (uint64_t(negative) << 63);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// 数字的状态转移图，转移表在编译期生成，每个字节只查两次表
+// 整数、小数和指数部分的数字各用一个状态，否则"1.5.3"、"1e5e3"这样的输入也能走完
+enum class NumberState : uint8_t {
+  NEGATIVE,
+  ZERO,       // 整数部分是0，后面只能是'.'、'e'、'E'或者结束
+  INT,        // 整数部分，第一位不是0
+  POINT,
+  FRAC,       // 小数部分
+  EXP,        // 'e'或'E'
+  EXP_SIGN,   // 指数的正负号
+  EXP_DIGIT,  // 指数部分
+  START,
+  INVALID,
+};
+// 转移表的列：0 '-'，1 '+'，2 '0'，3 '1'-'9'，4 未使用，5 'e' 'E'，6 '.'，7 未使用
+// 其它字符为-1
+constexpr std::array<int8_t, 256> make_char_column() {
+  std::array<int8_t, 256> column{};
+  for (auto &c : column) c = -1;
+  column['-'] = 0;
+  column['+'] = 1;
+  column['0'] = 2;
+  for (int c = '1'; c <= '9'; c++) column[c] = 3;
+  column['e'] = column['E'] = 5;
+  column['.'] = 6;
+  return column;
+}
+constexpr std::array<int8_t, 256> kCharColumn = make_char_column();
+
+using S = NumberState;
+// 按NumberState的顺序排列
+constexpr NumberState kTransition[][8] = {
+    /* NEGATIVE */
+    {S::INVALID, S::INVALID, S::ZERO, S::INT, S::INVALID, S::INVALID,
+     S::INVALID, S::INVALID},
+    /* ZERO */
+    {S::INVALID, S::INVALID, S::INVALID, S::INVALID, S::INVALID, S::EXP,
+     S::POINT, S::INVALID},
+    /* INT */
+    {S::INVALID, S::INVALID, S::INT, S::INT, S::INVALID, S::EXP,
+     S::POINT, S::INVALID},
+    /* POINT */
+    {S::INVALID, S::INVALID, S::FRAC, S::FRAC, S::INVALID, S::INVALID,
+     S::INVALID, S::INVALID},
+    /* FRAC */
+    {S::INVALID, S::INVALID, S::FRAC, S::FRAC, S::INVALID, S::EXP,
+     S::INVALID, S::INVALID},
+    /* EXP */
+    {S::EXP_SIGN, S::EXP_SIGN, S::EXP_DIGIT, S::EXP_DIGIT, S::INVALID,
+     S::INVALID, S::INVALID, S::INVALID},
+    /* EXP_SIGN */
+    {S::INVALID, S::INVALID, S::EXP_DIGIT, S::EXP_DIGIT, S::INVALID,
+     S::INVALID, S::INVALID, S::INVALID},
+    /* EXP_DIGIT */
+    {S::INVALID, S::INVALID, S::EXP_DIGIT, S::EXP_DIGIT, S::INVALID,
+     S::INVALID, S::INVALID, S::INVALID},
+    /* START */
+    {S::NEGATIVE, S::INVALID, S::ZERO, S::INT, S::INVALID, S::INVALID,
+     S::INVALID, S::INVALID},
+};
+}  // namespace
+
+const char *JsonNumber::scan(const char *first, const char *last) {
+  auto state = NumberState::START;
+  const char *p = first;
+  for (; p != last; p++) {
+    int8_t column = kCharColumn[static_cast<uint8_t>(*p)];
+    if (column < 0) break;  // 不在状态图里的字符，数字结束
+    state = kTransition[static_cast<int>(state)][column];
+    if (state == NumberState::INVALID) return nullptr;
+  }
+  if (state == NumberState::ZERO || state == NumberState::INT ||
+      state == NumberState::FRAC || state == NumberState::EXP_DIGIT)
+    return p;
+  return nullptr;
+}
+
+JsonNumber::AdjustedMantissa JsonNumber::compute_float(int64_t exp10,
+                                                       uint64_t mantissa) {
+  AdjustedMantissa answer{0, 0};
+  if (mantissa == 0 || exp10 < kSmallestPowerOfTen) return answer;
+  if (exp10 > kLargestPowerOfTen) {
+    answer.power2 = kInfinitePower;
+    return answer;
+  }
+  auto q = static_cast<int32_t>(exp10);
+  int lz = leading_zeros(mantissa);
+  mantissa <<= lz;
+
+  // 需要55位精度：52位尾数 + 隐含位 + 舍入位 + 判断进位的一位
+  const uint64_t precision_mask = uint64_t(0xFFFFFFFFFFFFFFFF) >> 55;
+  size_t index = 2 * size_t(q - kSmallestPowerOfTen);
+  uint64_t high, low;
+  full_multiplication(mantissa, kPowerOfFive128[index], high, low);
+  if ((high & precision_mask) == precision_mask) {
+    // 低位全是1时再乘上5^q的低64位，看会不会进位
+    uint64_t second_high, second_low;
+    full_multiplication(mantissa, kPowerOfFive128[index + 1], second_high,
+                        second_low);
+    low += second_high;
+    if (second_high > low) high++;
+  }
+  if (low == 0xFFFFFFFFFFFFFFFF && (q < -27 || q > 55)) {
+    // 近似误差可能影响结果，交给慢路径
+    answer.power2 = -1;
+    return answer;
+  }
+
+  int upperbit = int(high >> 63);
+  int shift = upperbit + 64 - kMantissaExplicitBits - 3;
+  answer.mantissa = high >> shift;
+  answer.power2 = binary_power(q) + upperbit - lz - kMinimumExponent;
+  if (answer.power2 <= 0) {
+    // 非规格化数
+    if (-answer.power2 + 1 >= 64) {
+      answer.mantissa = 0;
+      answer.power2 = 0;
+      return answer;
+    }
+    answer.mantissa >>= -answer.power2 + 1;
+    answer.mantissa += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+    answer.power2 =
+        answer.mantissa < (uint64_t(1) << kMantissaExplicitBits) ? 0 : 1;
+    return answer;
+  }
+
+  // 一般向上舍入，恰好在正中间时要舍入到偶数
+  if (low <= 1 && q >= kMinExponentRoundToEven &&
+      q <= kMaxExponentRoundToEven && (answer.mantissa & 3) == 1 &&
+      (answer.mantissa << shift) == high) {
+    answer.mantissa &= ~uint64_t(1);
+  }
+  answer.mantissa += answer.mantissa & 1;
+  answer.mantissa >>= 1;
+  if (answer.mantissa >= (uint64_t(2) << kMantissaExplicitBits)) {
+    answer.mantissa = uint64_t(1) << kMantissaExplicitBits;
+    answer.power2++;
+  }
+  answer.mantissa &= ~(uint64_t(1) << kMantissaExplicitBits);
+  if (answer.power2 >= kInfinitePower) {
+    answer.power2 = kInfinitePower;
+    answer.mantissa = 0;
+  }
+  return answer;
+}
+
+bool JsonNumber::compute_double(bool negative, uint64_t mantissa,
+                                int64_t exp10, double &value) {
+  // Clinger：两个操作数都能精确表示，一次IEEE运算就是正确舍入的结果
+  if (exp10 >= -22 && exp10 <= 22 && mantissa <= (uint64_t(1) << 53)) {
+    auto v = static_cast<double>(mantissa);
+    v = exp10 < 0 ? v / kExactPowersOfTen[-exp10] : v * kExactPowersOfTen[exp10];
+    value = negative ? -v : v;
+    return true;
+  }
+  AdjustedMantissa am = compute_float(exp10, mantissa);
+  if (am.power2 < 0) return false;
+  value = to_double(negative, am.mantissa, am.power2);
+  return true;
+}
+
+JsonNumber::Value JsonNumber::parse(const char *first, const char *last) {
+  Value value{};
+  const char *p = first;
+  bool negative = *p == '-';
+  if (negative) p++;
+
+  // 19位十进制数一定放得下uint64_t，第20位要检查溢出
+  const char *digits = p;
+  uint64_t integer = 0;
+  for (; p != last && is_digit(*p) && p - digits < 19; p++)
+    integer = integer * 10 + (*p - '0');
+  if (p != last && is_digit(*p)) {
+    uint64_t digit = *p - '0';
+    if (integer <= (UINT64_MAX - digit) / 10) {
+      integer = integer * 10 + digit;
+      p++;
+    }
+  }
+
+  const uint64_t int64_limit = uint64_t(INT64_MAX) + negative;
+  if (p != last || (negative && integer == 0) ||
+      (negative && integer > int64_limit)) {
+    // 有小数或指数部分、超出范围，或者是-0
+    value.kind = Kind::DOUBLE;
+    value.d = parse_double(first, last);
+  } else if (negative) {
+    value.kind = Kind::INT64;
+    value.i = static_cast<int64_t>(0 - integer);
+  } else if (integer <= uint64_t(INT64_MAX)) {
+    value.kind = Kind::INT64;
+    value.i = static_cast<int64_t>(integer);
+  } else {
+    value.kind = Kind::UINT64;
+    value.u = integer;
+  }
+  return value;
+}
+
+double JsonNumber::parse_double(const char *first, const char *last) {
+  const char *p = first;
+  bool negative = *p == '-';
+  if (negative) p++;
+
+  // 最多保留19位有效数字，uint64_t放得下
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int64_t exp10 = 0;
+  bool truncated = false;
+  for (; p != last && is_digit(*p); p++) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) digits++;
+    } else {
+      truncated |= *p != '0';
+      exp10++;
+    }
+  }
+  if (p != last && *p == '.') {
+    for (p++; p != last && is_digit(*p); p++) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) digits++;
+        exp10--;
+      } else {
+        truncated |= *p != '0';
+      }
+    }
+  }
+  if (p != last && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool exp_negative = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    int64_t exp = 0;
+    for (; p != last && is_digit(*p); p++) {
+      // 再大的指数结果也只是0或者无穷
+      if (exp < 100000) exp = exp * 10 + (*p - '0');
+    }
+    exp10 += exp_negative ? -exp : exp;
+  }
+
+  if (mantissa == 0) return negative ? -0.0 : 0.0;
+
+  double value;
+  if (!truncated) {
+    if (compute_double(negative, mantissa, exp10, value)) return value;
+  } else {
+    // 丢掉的数字让真实值落在[mantissa, mantissa + 1)之间，两头结果一样就没有问题
+    AdjustedMantissa lower = compute_float(exp10, mantissa);
+    AdjustedMantissa upper = compute_float(exp10, mantissa + 1);
+    if (lower.power2 >= 0 && lower == upper)
+      return to_double(negative, lower.mantissa, lower.power2);
+  }
+  return slow_path(first, last, negative, exp10);
+}
+
+double JsonNumber::slow_path(const char *first, const char *last,
+                             bool negative, int64_t exp10) {
+  double value = 0;
+  auto [ptr, ec] = std::from_chars(first, last, value);
+  if (ec == std::errc::result_out_of_range) {
+    value = exp10 > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+    value = negative ? -value : value;
+  }
+  return value;
+}
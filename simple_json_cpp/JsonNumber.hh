@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 十进制数字转double，结果和strtod一样是正确舍入的
+//   1. 有效数字不超过2^53且10的指数在±22以内时，一次浮点乘除就是精确结果(Clinger)
+//   2. 否则用128位的5^q近似值做一次乘法得到结果(Eisel-Lemire)
+//   3. 极少数无法确定舍入方向的情况交给std::from_chars
+class JsonNumber {
+ public:
+  // 从first开始按状态转移图扫描一个数字，返回数字后面的位置，不合法时返回nullptr
+  static const char *scan(const char *first, const char *last);
+
+  // 数字的存储方式：没有小数和指数部分、并且放得下64位整数时存成整数，否则存成double
+  //   非负数优先用int64，超过INT64_MAX才用uint64；"-0"要保留符号，存成double
+  enum class Kind : uint8_t {
+    DOUBLE,
+    INT64,
+    UINT64,
+  };
+  struct Value {
+    Kind kind;
+    union {
+      double d;
+      int64_t i;
+      uint64_t u;
+    };
+  };
+  // [first, last)必须是合法的JSON数字，整数不经过任何浮点运算
+  static Value parse(const char *first, const char *last);
+
+  // [first, last)必须是合法的JSON数字
+  static double parse_double(const char *first, const char *last);
+
+  // 计算 mantissa * 10^exp10，无法确定结果时返回false
+  static bool compute_double(bool negative, uint64_t mantissa, int64_t exp10,
+                             double &value);
+
+ private:
+  static constexpr int kSmallestPowerOfTen = -342;
+  static constexpr int kLargestPowerOfTen = 308;
+  static const uint64_t kPowerOfFive128[];
+
+  // Eisel-Lemire，返回值的mantissa和二进制指数已经是double的格式，
+  // power2为-1表示无法确定
+  struct AdjustedMantissa {
+    uint64_t mantissa;
+    int32_t power2;
+    bool operator==(const AdjustedMantissa &rhs) const {
+      return mantissa == rhs.mantissa && power2 == rhs.power2;
+    }
+  };
+  static AdjustedMantissa compute_float(int64_t exp10, uint64_t mantissa);
+
+  static double slow_path(const char *first, const char *last, bool negative,
+                          int64_t exp10);
+};
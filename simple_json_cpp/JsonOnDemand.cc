@@ -0,0 +1,290 @@
+#include "JsonOnDemand.hh"
+
+#include <array>
+
+namespace {
+inline const char *skip_space(const char *p, const char *end) {
+  return JsonSimd::skip_whitespace(p, end);
+}
+
+// p指向起始引号，返回结束引号之后的位置，没有结束引号时返回nullptr
+inline const char *skip_string(const char *p, const char *end) {
+  for (p++;;) {
+    p = JsonSimd::find_string_special(p, end);
+    if (p == end) return nullptr;
+    if (*p == '\"') return p + 1;
+    // 反斜杠连同后面的字符一起跳过，控制字符留给真正解析时报错
+    p += *p == '\\' ? 2 : 1;
+    if (p > end) return nullptr;
+  }
+}
+
+enum : uint8_t {
+  kOther = 0,
+  kQuote,
+  kOpen,
+  kClose,
+  kDelimiter,  // 标量值之后可能出现的字节
+};
+
+constexpr std::array<uint8_t, 256> make_skip_class() {
+  std::array<uint8_t, 256> table{};
+  table['"'] = kQuote;
+  table['{'] = table['['] = kOpen;
+  table['}'] = table[']'] = kClose;
+  table[','] = table[' '] = table['\t'] = table['\n'] = table['\r'] = kDelimiter;
+  return table;
+}
+constexpr std::array<uint8_t, 256> kSkipClass = make_skip_class();
+
+// 跳过p处的值，不校验内容，只匹配括号和引号，失败时返回nullptr
+const char *skip_value(const char *p, const char *end) {
+  switch (kSkipClass[static_cast<uint8_t>(*p)]) {
+    case kQuote:
+      return skip_string(p, end);
+    case kOpen: {
+      size_t depth = 0;
+      while (p != end) {
+        switch (kSkipClass[static_cast<uint8_t>(*p)]) {
+          case kQuote:
+            if ((p = skip_string(p, end)) == nullptr) return nullptr;
+            continue;
+          case kOpen:
+            depth++;
+            break;
+          case kClose:
+            if (--depth == 0) return p + 1;
+            break;
+          default:
+            break;
+        }
+        p++;
+      }
+      return nullptr;
+    }
+    case kClose:
+    case kDelimiter:
+      return nullptr;
+    default:
+      while (p != end && kSkipClass[static_cast<uint8_t>(*p)] == kOther) p++;
+      return p;
+  }
+}
+
+}  // namespace
+
+JParseError JsonParser::parse(std::string_view str, JsonOnDemand &doc) {
+  reset_context(str.data(), str.size(), std::pmr::new_delete_resource());
+  skip_space();
+  doc.json_ = str;
+  doc.root_ = curr_index_;
+  doc.err_ = curr_index_ == size_ ? JSON_PARSE_EXPECT_VALUE : JSON_PARSE_OK;
+  return doc.err_;
+}
+
+EJsonType JsonCursor::get_type() const {
+  if (err_ != JSON_PARSE_OK) return EJsonType::JSON_INVALID;
+  switch (first()) {
+    case 'n':
+      return EJsonType::JSON_NULL;
+    case 't':
+      return EJsonType::JSON_TRUE;
+    case 'f':
+      return EJsonType::JSON_FALSE;
+    case '\"':
+      return EJsonType::JSON_STRING;
+    case '[':
+      return EJsonType::JSON_ARRAY;
+    case '{':
+      return EJsonType::JSON_OBJECT;
+    default:
+      break;
+  }
+  JsonParser parser;
+  parser.reset_context(json_.data(), json_.size(),
+                       std::pmr::new_delete_resource());
+  parser.curr_index_ = index_;
+  JsonNumber::Value num;
+  if (parser.parse_number_raw(num) != JSON_PARSE_OK)
+    return EJsonType::JSON_INVALID;
+  switch (num.kind) {
+    case JsonNumber::Kind::INT64:
+      return EJsonType::JSON_INT64;
+    case JsonNumber::Kind::UINT64:
+      return EJsonType::JSON_UINT64;
+    default:
+      return EJsonType::JSON_NUMBER;
+  }
+}
+
+// quote是key起始引号的位置，size包括两个引号
+// 原文里没有'\\'时直接比较；有转义时从输入里解码再比较，解码只会变短
+bool JsonCursor::key_equals(size_t quote, size_t size,
+                            std::string_view key) const {
+  std::string_view raw = json_.substr(quote + 1, size - 2);
+  if (raw.find('\\') == std::string_view::npos) return raw == key;
+  if (raw.size() < key.size()) return false;
+  JsonParser parser;
+  parser.reset_context(json_.data(), json_.size(),
+                       std::pmr::new_delete_resource());
+  parser.curr_index_ = quote;
+  std::string str;
+  return parser.parse_string_raw(str) == JSON_PARSE_OK && str == key;
+}
+
+// 逐个成员比较key，值直接跳过，错误码与DOM的parse_object一致
+// 重复的key和DOM一样取最后一个，所以匹配之后还要走到'}'
+JsonCursor JsonCursor::get_object_element_by(std::string_view key) const {
+  if (err_ != JSON_PARSE_OK) return *this;
+  BOOST_ASSERT_MSG(first() == '{', "type is not json_object");
+  const char *begin = json_.data();
+  const char *end = begin + json_.size();
+  const char *p = skip_space(begin + index_ + 1, end);
+  if (p != end && *p == '}') return failed(JSON_PARSE_OBJECT_KEY_NOT_EXIST);
+  const char *found = nullptr;
+  for (;;) {
+    if (p == end || *p != '\"') return failed(JSON_PARSE_OBJECT_MISS_KEY);
+    const char *key_end = skip_string(p, end);
+    if (key_end == nullptr) return failed(JSON_PARSE_OBJECT_MISS_KEY);
+    bool match = key_equals(p - begin, key_end - p, key);
+    p = skip_space(key_end, end);
+    if (p == end || *p != ':') return failed(JSON_PARSE_OBJECT_MISS_COLON);
+    p = skip_space(p + 1, end);
+    if (p == end) return failed(JSON_PARSE_OBJECT_MISS_MEMBER);
+    if (match) found = p;
+    if ((p = skip_value(p, end)) == nullptr)
+      return failed(JSON_PARSE_OBJECT_MISS_MEMBER);
+    p = skip_space(p, end);
+    if (p == end) return failed(JSON_PARSE_OBJECT_MISS_RIGHT_BRACKET);
+    if (*p == '}') {
+      if (found == nullptr) return failed(JSON_PARSE_OBJECT_KEY_NOT_EXIST);
+      return JsonCursor(json_, found - begin, JSON_PARSE_OK);
+    }
+    if (*p != ',') return failed(JSON_PARSE_OBJECT_MISS_COMMA);
+    p = skip_space(p + 1, end);
+  }
+}
+
+JsonCursor JsonCursor::get_array_element_by(size_t index) const {
+  if (err_ != JSON_PARSE_OK) return *this;
+  BOOST_ASSERT_MSG(first() == '[', "type is not json_array");
+  for (auto it = begin(); it != end(); ++it, index--) {
+    if (index == 0 || it.err_ != JSON_PARSE_OK) return *it;
+  }
+  return failed(JSON_PARSE_ARRAY_INDEX_OUT_OF_RANGE);
+}
+
+JsonCursor::Iterator JsonCursor::begin() const {
+  if (err_ != JSON_PARSE_OK) return Iterator(json_, index_, err_);
+  BOOST_ASSERT_MSG(first() == '[', "type is not json_array");
+  const char *begin = json_.data();
+  const char *end = begin + json_.size();
+  const char *p = skip_space(begin + index_ + 1, end);
+  if (p == end) return Iterator(json_, index_, JSON_PARSE_ARRAY_MISS_VALUE);
+  if (*p == ']') return this->end();
+  return Iterator(json_, p - begin, JSON_PARSE_OK);
+}
+
+JsonCursor::Iterator JsonCursor::end() const {
+  return Iterator(json_, Iterator::kEnd, JSON_PARSE_OK);
+}
+
+// 跳过当前元素和后面的逗号，错误码与DOM的parse_array一致
+JsonCursor::Iterator &JsonCursor::Iterator::operator++() {
+  if (err_ != JSON_PARSE_OK) {
+    index_ = kEnd;
+    return *this;
+  }
+  const char *begin = json_.data();
+  const char *end = begin + json_.size();
+  const char *p = skip_value(begin + index_, end);
+  if (p == nullptr) {
+    err_ = JSON_PARSE_ARRAY_MISS_VALUE;
+    return *this;
+  }
+  p = skip_space(p, end);
+  if (p == end) {
+    err_ = JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET;
+  } else if (*p == ']') {
+    index_ = kEnd;
+  } else if (*p != ',') {
+    err_ = JSON_PARSE_ARRAY_MISS_COMMA;
+  } else {
+    p = skip_space(p + 1, end);
+    if (p == end || *p == ']')
+      err_ = p == end ? JSON_PARSE_ARRAY_MISS_VALUE
+                      : JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA;
+    else
+      index_ = p - begin;
+  }
+  return *this;
+}
+
+// 取值时复用JsonParser的解析函数，从游标的位置开始解析
+std::string JsonCursor::get_string() const {
+  BOOST_ASSERT_MSG(err_ == JSON_PARSE_OK, "cursor has error");
+  BOOST_ASSERT_MSG(first() == '\"', "type is not json_string");
+  JsonParser parser;
+  parser.reset_context(json_.data(), json_.size(),
+                       std::pmr::new_delete_resource());
+  parser.curr_index_ = index_;
+  std::string str;
+  JParseError err = parser.parse_string_raw(str);
+  BOOST_ASSERT_MSG(err == JSON_PARSE_OK, "invalid json_string");
+  (void)err;
+  return str;
+}
+
+void *JsonCursor::get_null() const {
+  BOOST_ASSERT_MSG(err_ == JSON_PARSE_OK, "cursor has error");
+  BOOST_ASSERT_MSG(json_.substr(index_, 4) == "null", "type is not json_null");
+  return nullptr;
+}
+
+bool JsonCursor::get_boolean() const {
+  BOOST_ASSERT_MSG(err_ == JSON_PARSE_OK, "cursor has error");
+  if (json_.substr(index_, 4) == "true") return true;
+  BOOST_ASSERT_MSG(json_.substr(index_, 5) == "false", "type is not json_bool");
+  return false;
+}
+
+JsonNumber::Value JsonCursor::parse_number() const {
+  BOOST_ASSERT_MSG(err_ == JSON_PARSE_OK, "cursor has error");
+  JsonParser parser;
+  parser.reset_context(json_.data(), json_.size(),
+                       std::pmr::new_delete_resource());
+  parser.curr_index_ = index_;
+  JsonNumber::Value num{};
+  JParseError err = parser.parse_number_raw(num);
+  BOOST_ASSERT_MSG(err == JSON_PARSE_OK, "type is not json_number");
+  (void)err;
+  return num;
+}
+
+double JsonCursor::get_number() const {
+  JsonNumber::Value num = parse_number();
+  switch (num.kind) {
+    case JsonNumber::Kind::INT64:
+      return static_cast<double>(num.i);
+    case JsonNumber::Kind::UINT64:
+      return static_cast<double>(num.u);
+    default:
+      return num.d;
+  }
+}
+
+int64_t JsonCursor::get_int64() const {
+  JsonNumber::Value num = parse_number();
+  BOOST_ASSERT_MSG(num.kind == JsonNumber::Kind::INT64, "type is not json_int64");
+  return num.i;
+}
+
+uint64_t JsonCursor::get_uint64() const {
+  JsonNumber::Value num = parse_number();
+  if (num.kind == JsonNumber::Kind::INT64) {
+    BOOST_ASSERT_MSG(num.i >= 0, "json_int64 is negative");
+    return static_cast<uint64_t>(num.i);
+  }
+  BOOST_ASSERT_MSG(num.kind == JsonNumber::Kind::UINT64, "type is not json_uint64");
+  return num.u;
+}
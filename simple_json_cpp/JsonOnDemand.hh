@@ -0,0 +1,104 @@
+#pragma once
+#include "JsonParse.hh"
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+// 按需解析：parse时只记下输入，访问到哪里才解析到哪里
+//   JsonOnDemand doc;
+//   JsonParse::parse(json, doc);
+//   doc.root()["user"]["id"].get_int64();
+// 查找对象成员和数组元素时，用不到的值只做括号/引号匹配直接跳过，不做校验，
+// 所以没有访问到的部分即使不合法也不会报错
+// 重复的key和DOM一样取最后一个，查找成员时总要扫到对象的'}'
+// 输入必须比JsonOnDemand以及从它得到的JsonCursor活得久
+class JsonCursor;
+
+class JsonOnDemand {
+  friend JsonParser;
+
+ public:
+  [[nodiscard]] JsonCursor root() const;
+
+ private:
+  std::string_view json_;
+  size_t root_{0};
+  JParseError err_{JSON_PARSE_EXPECT_VALUE};
+};
+
+// 指向某个值的第一个字节，只是位置，复制的开销很小
+// 查找过程中出错时，error()返回错误码，之后的查找都返回同一个错误
+// 取值的接口与JsonType保持一致，类型不对或者值不合法时断言失败
+class JsonCursor {
+  friend JsonOnDemand;
+
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = JsonCursor;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = JsonCursor;
+
+    // 数组不合法时，最后一个元素带着错误码，然后结束
+    JsonCursor operator*() const { return JsonCursor(json_, index_, err_); }
+    Iterator &operator++();
+    bool operator==(const Iterator &rhs) const { return index_ == rhs.index_; }
+    bool operator!=(const Iterator &rhs) const { return index_ != rhs.index_; }
+
+   private:
+    friend JsonCursor;
+    static constexpr size_t kEnd = SIZE_MAX;
+    Iterator(std::string_view json, size_t index, JParseError err)
+        : json_(json), index_(index), err_(err) {}
+    std::string_view json_;
+    size_t index_;
+    JParseError err_;
+  };
+
+  [[nodiscard]] JParseError error() const { return err_; }
+  [[nodiscard]] EJsonType get_type() const;
+
+  JsonCursor operator[](std::string_view key) const {
+    return get_object_element_by(key);
+  }
+  JsonCursor operator[](size_t index) const {
+    return get_array_element_by(index);
+  }
+  [[nodiscard]] JsonCursor get_object_element_by(std::string_view key) const;
+  [[nodiscard]] JsonCursor get_array_element_by(size_t index) const;
+
+  // 遍历数组的元素
+  [[nodiscard]] Iterator begin() const;
+  [[nodiscard]] Iterator end() const;
+
+  [[nodiscard]] std::string get_string() const;
+  [[nodiscard]] void *get_null() const;
+  [[nodiscard]] bool get_boolean() const;
+  [[nodiscard]] double get_number() const;
+  [[nodiscard]] int64_t get_int64() const;
+  [[nodiscard]] uint64_t get_uint64() const;
+
+ private:
+  JsonCursor(std::string_view json, size_t index, JParseError err)
+      : json_(json), index_(index), err_(err) {}
+  [[nodiscard]] JsonCursor failed(JParseError err) const {
+    return JsonCursor(json_, index_, err);
+  }
+  // 比较输入里quote处的key和key，带转义时先解码
+  [[nodiscard]] bool key_equals(size_t quote, size_t size,
+                                std::string_view key) const;
+  [[nodiscard]] char first() const { return json_[index_]; }
+  [[nodiscard]] JsonNumber::Value parse_number() const;
+
+  std::string_view json_;
+  size_t index_;
+  JParseError err_;
+};
+
+inline JsonCursor JsonOnDemand::root() const {
+  return JsonCursor(json_, root_, err_);
+}
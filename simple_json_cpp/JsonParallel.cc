@@ -0,0 +1,75 @@
+#include "JsonParallel.hh"
+#include "JsonParse.hh"
+#include "JsonStructural.hh"
+
+// 1. 建结构索引，沿着索引数括号的深度，找到顶层数组的'['、深度为1的','和对应的']'
+// 2. 根数组按元素个数一次建好，元素分成若干段交给各个线程，
+//    每个线程把元素直接解析进自己那一段的位置里，不需要再拼接
+// 3. 每段用自己的arena，结构索引只用来切分，元素照常解析
+// 不是顶层数组、元素太少或者有元素出错时，退回到串行解析，错误码和串行时完全一样
+JParseError JsonParser::parse_parallel(std::string_view str, JsonDocument &doc,
+                                       size_t threads) {
+  threads = JsonParallel::thread_count(threads);
+  JsonStructuralIndex index;
+  if (!index.build(str)) return JsonParse::parse(str, doc);
+  auto &positions = index.positions();
+
+  // bounds里是'['、顶层','和']'在positions里的下标
+  std::vector<size_t> bounds;
+  if (positions.empty() || str[positions[0]] != '[')
+    return JsonParse::parse(str, doc);
+  size_t depth = 0;
+  size_t i = 0;
+  for (; i < positions.size(); i++) {
+    char c = str[positions[i]];
+    if (c == '[' || c == '{') {
+      if (depth++ == 0) bounds.push_back(i);
+    } else if (c == ']' || c == '}') {
+      if (--depth == 0) break;
+    } else if (c == ',' && depth == 1) {
+      bounds.push_back(i);
+    }
+  }
+  // 没有闭合或者后面还有别的值，交给串行解析报错
+  if (i + 1 != positions.size() || str[positions[i]] != ']')
+    return JsonParse::parse(str, doc);
+  bounds.push_back(i);
+  size_t elements = bounds.size() - 1;
+  // 元素已经在根数组里面一层
+  size_t max_depth = JsonParse::max_depth();
+  JsonKeyPool *key_pool = JsonParse::key_pool();
+  bool validate_utf8 = JsonParse::validate_utf8();
+  if (threads == 1 || elements < 2 || max_depth == 0)
+    return JsonParse::parse(str, doc);
+
+  doc.clear();
+  JsonType root;
+  JsonType *array = root.set_array(elements, &doc.arena_);
+
+  size_t tasks = std::min(elements, threads * 4);
+  for (size_t t = 0; t < tasks; t++)
+    doc.shard_arenas_.push_back(std::make_unique<JsonArena>());
+  std::atomic<bool> failed{false};
+  JsonParallel::for_each(tasks, threads, [&](size_t t) {
+    JsonParser worker;
+    worker.set_max_depth(max_depth - 1);
+    worker.set_key_pool(key_pool);
+    worker.set_validate_utf8(validate_utf8);
+    for (size_t e = elements * t / tasks; e < elements * (t + 1) / tasks; e++) {
+      if (failed.load(std::memory_order_relaxed)) break;
+      // 元素是两个分隔符之间的 ws value ws
+      size_t begin = positions[bounds[e]] + 1;
+      size_t end = positions[bounds[e + 1]];
+      worker.reset_context(str.data(), end, doc.shard_arenas_[t].get());
+      worker.curr_index_ = begin;
+      if (worker.parse_root(array[e]) != JSON_PARSE_OK) failed = true;
+    }
+  });
+  if (failed) {
+    // 树在doc的arena里，重新解析时会整块回收，不能再析构
+    root.detach();
+    return JsonParse::parse(str, doc);
+  }
+  doc.root_ = std::move(root);
+  return JSON_PARSE_OK;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// parse_many和parse_parallel共用的多线程工具
+class JsonParallel {
+ public:
+  // 0表示用全部核
+  static size_t thread_count(size_t threads) {
+    if (threads != 0) return threads;
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+
+  // 在threads个线程上执行f(0) ... f(tasks - 1)，当前线程也参与，全部完成后返回
+  // 任务从共享的计数器领取，任务比线程多几倍时各个线程的负载比较均匀
+  template <typename F>
+  static void for_each(size_t tasks, size_t threads, F &&f) {
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+      for (size_t i; (i = next.fetch_add(1)) < tasks;) f(i);
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, tasks); i++)
+      workers.emplace_back(work);
+    work();
+    for (auto &worker : workers) worker.join();
+  }
+};
@@ -2,42 +2,332 @@
 // Created by Pawn on 2020/8/10.
 //
 #include "JsonParse.hh"
+#include "JsonWriter.hh"
 
+#include <mutex>
 
-thread_local const char *JsonParse::context_{};
-thread_local size_t JsonParse::size_{};
-thread_local size_t JsonParse::curr_index_{};
+static_assert(sizeof(JsonType) == 16, "JsonType should stay 16 bytes");
+
+JsonParser &JsonParse::local() {
+  thread_local JsonParser parser;
+  return parser;
+}
+
+JsonWriter &JsonParse::writer() {
+  thread_local JsonWriter writer;
+  return writer;
+}
+
+std::string JsonParse::stringfy(const JsonType &value) {
+  return std::string(writer().write(value));
+}
+
+size_t JsonParse::stringfy(const JsonType &value, char *out, size_t capacity) {
+  return writer().write(value, out, capacity);
+}
+
+
+// 不递归：子容器从树上摘下来放进pending，一个一个释放，嵌套多深都不会压爆栈
+void JsonType::destroy() {
+    std::vector<JsonType> pending;
+    free_block(pending);
+    while (!pending.empty()) {
+        JsonType value = std::move(pending.back());
+        pending.pop_back();
+        value.free_block(pending);
+    }
+}
+
+// 只释放自己的块，子字符串顺便释放，子容器留给调用者
+void JsonType::free_block(std::vector<JsonType> &pending) {
+    auto release_child = [&pending](JsonType &child) {
+        if (child.storage_ != Storage::BLOCK) return;
+        if (child.type_ == EJsonType::JSON_STRING)
+            child.free_block(pending);
+        else
+            pending.push_back(std::move(child));
+    };
+    switch (type_) {
+        case EJsonType::JSON_STRING: {
+            auto *block = load<JsonStringBlock *>();
+            block->resource->deallocate(block, sizeof(JsonStringBlock) + block->size,
+                                        alignof(JsonStringBlock));
+            break;
+        }
+        case EJsonType::JSON_ARRAY: {
+            auto *block = load<JsonArrayBlock *>();
+            JsonType *elements = block->elements();
+            for (size_t i = 0; i < block->size; i++) release_child(elements[i]);
+            block->resource->deallocate(
+                block, sizeof(JsonArrayBlock) + block->size * sizeof(JsonType),
+                alignof(JsonArrayBlock));
+            break;
+        }
+        case EJsonType::JSON_OBJECT: {
+            auto *block = load<JsonObjectBlock *>();
+            JsonMember *members = block->members();
+            for (size_t i = 0; i < block->size; i++) release_child(members[i].value);
+            if (const uint32_t *index = block->index.load())
+                block->resource->deallocate(const_cast<uint32_t *>(index),
+                                            block->index_capacity() * sizeof(uint32_t),
+                                            alignof(uint32_t));
+            block->resource->deallocate(block, block->block_bytes(),
+                                        alignof(JsonObjectBlock));
+            break;
+        }
+        default:
+            break;
+    }
+    detach();
+}
+
+void JsonType::set_string(std::string_view str,
+                          std::pmr::memory_resource *resource) {
+    type_ = EJsonType::JSON_STRING;
+    if (str.size() <= kSmallSize) {
+        memcpy(bytes_, str.data(), str.size());
+        bytes_[kSmallSize] = static_cast<char>(str.size());
+        storage_ = Storage::SMALL;
+        return;
+    }
+    void *mem = resource->allocate(sizeof(JsonStringBlock) + str.size(),
+                                   alignof(JsonStringBlock));
+    auto *block = new (mem) JsonStringBlock{resource, str.size()};
+    memcpy(block + 1, str.data(), str.size());
+    store(block);
+    storage_ = Storage::BLOCK;
+}
+
+void JsonType::set_borrowed(std::string_view str,
+                            std::pmr::memory_resource *resource) {
+    if (str.size() > kMaxViewSize) {
+        set_string(str, resource);
+        return;
+    }
+    type_ = EJsonType::JSON_STRING;
+    store(str.data());
+    store(static_cast<uint32_t>(str.size()), sizeof(const char *));
+    storage_ = Storage::VIEW;
+}
+
+JsonType *JsonType::set_array(size_t size, std::pmr::memory_resource *resource) {
+    void *mem = resource->allocate(sizeof(JsonArrayBlock) + size * sizeof(JsonType),
+                                   alignof(JsonArrayBlock));
+    auto *block = new (mem) JsonArrayBlock{resource, size};
+    JsonType *elements = block->elements();
+    for (size_t i = 0; i < size; i++) new (elements + i) JsonType();
+    type_ = EJsonType::JSON_ARRAY;
+    store(block);
+    storage_ = Storage::BLOCK;
+    return elements;
+}
+
+JsonMember *JsonType::set_object(size_t size, size_t key_bytes,
+                                 std::pmr::memory_resource *resource) {
+    size_t bytes = sizeof(JsonObjectBlock) + size * sizeof(JsonMember) + key_bytes;
+    void *mem = resource->allocate(bytes, alignof(JsonObjectBlock));
+    auto *block = new (mem) JsonObjectBlock{resource, size, key_bytes};
+    JsonMember *members = block->members();
+    for (size_t i = 0; i < size; i++) new (members + i) JsonMember();
+    type_ = EJsonType::JSON_OBJECT;
+    store(block);
+    storage_ = Storage::BLOCK;
+    return members;
+}
+
+// 出错时容器可能还没有建好，当成空的
+JsonArrayBlock *JsonType::array_block() const {
+    BOOST_ASSERT_MSG(type_ == EJsonType::JSON_ARRAY, "type is not json_array");
+    return has_block() ? load<JsonArrayBlock *>() : nullptr;
+}
+
+JsonObjectBlock *JsonType::object_block() const {
+    BOOST_ASSERT_MSG(type_ == EJsonType::JSON_OBJECT, "type is not json_object");
+    return has_block() ? load<JsonObjectBlock *>() : nullptr;
+}
+
+namespace {
+// 建索引很少发生，各个对象共用一把锁，也保护了从arena里分配索引
+std::mutex index_mutex;
+
+inline size_t key_hash(std::string_view key) {
+    return std::hash<std::string_view>()(key);
+}
+
+// 从同一个JsonKeyPool来的key地址相同，不用比内容
+inline bool key_equals(const JsonMember &member, std::string_view key) {
+    if (member.key_data == key.data()) return member.key_size == key.size();
+    return member.key() == key;
+}
+}  // namespace
+
+const uint32_t *JsonObjectBlock::build_index() {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    if (const uint32_t *built = index.load(std::memory_order_acquire))
+        return built;
+    size_t capacity = index_capacity();
+    auto *slots = static_cast<uint32_t *>(
+        resource->allocate(capacity * sizeof(uint32_t), alignof(uint32_t)));
+    std::fill(slots, slots + capacity, 0);
+    JsonMember *all = members();
+    // 按顺序插入，重复的key后面的覆盖前面的
+    for (size_t i = 0; i < size; i++) {
+        size_t slot = key_hash(all[i].key()) & (capacity - 1);
+        while (slots[slot] != 0 && all[slots[slot] - 1].key() != all[i].key())
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = static_cast<uint32_t>(i + 1);
+    }
+    index.store(slots, std::memory_order_release);
+    return slots;
+}
+
+JsonMember *JsonObjectBlock::find(std::string_view key) {
+    if (size <= kLinearSize) return find_linear(key);
+    return find_indexed(key, key_hash(key));
+}
+
+JsonMember *JsonObjectBlock::find(std::string_view key, size_t hash) {
+    if (size <= kLinearSize) return find_linear(key);
+    return find_indexed(key, hash);
+}
+
+JsonMember *JsonObjectBlock::find_linear(std::string_view key) {
+    JsonMember *all = members();
+    for (size_t i = size; i-- > 0;) {
+        if (key_equals(all[i], key)) return all + i;
+    }
+    return nullptr;
+}
+
+JsonMember *JsonObjectBlock::find_indexed(std::string_view key, size_t hash) {
+    JsonMember *all = members();
+    const uint32_t *slots = index.load(std::memory_order_acquire);
+    if (slots == nullptr) slots = build_index();
+    size_t mask = index_capacity() - 1;
+    for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+        if (key_equals(all[slots[slot] - 1], key)) return all + slots[slot] - 1;
+    }
+    return nullptr;
+}
 
 JsonType &JsonType::operator[](size_t index) {
-     return impl_->get_array_element_by(index);
+     return get_array_element_by(index);
 }
 
 EJsonType JsonType::get_type() const {
-    return impl_->get_type();
+    return type_;
 }
 
 std::string JsonType::get_string() {
+    auto str = get_string_view();
+    return std::string(str.data(), str.size());
+}
 
-    return impl_->get_string();
-
+std::string_view JsonType::get_string_view() const {
+    BOOST_ASSERT_MSG(type_ == EJsonType::JSON_STRING, "type is not json_string");
+    switch (storage_) {
+        case Storage::SMALL:
+            return std::string_view(bytes_, static_cast<uint8_t>(bytes_[kSmallSize]));
+        case Storage::VIEW:
+            return std::string_view(load<const char *>(),
+                                    load<uint32_t>(sizeof(const char *)));
+        default: {
+            auto *block = load<JsonStringBlock *>();
+            return std::string_view(block->data(), block->size);
+        }
+    }
 }
 
+// 出错时容器可能还没有建好，当成空的
 JsonType &JsonType::get_array_element_by(size_t index) {
-    return impl_->get_array_element_by(index);
+    JsonArrayBlock *block = array_block();
+    BOOST_ASSERT_MSG(block != nullptr && index < block->size, "index out of json_array");
+    return block->elements()[index];
+}
+
+JsonType &JsonType::get_object_element_by(std::string_view key) {
+    JsonObjectBlock *block = object_block();
+    JsonMember *member = block != nullptr ? block->find(key) : nullptr;
+    BOOST_ASSERT_MSG(member != nullptr, "key not exist, please check key spelling");
+    return member->value;
+}
+
+JsonType &JsonType::get_object_element_by(const JsonKey &key) {
+    JsonObjectBlock *block = object_block();
+    JsonMember *member =
+        block != nullptr ? block->find(key.view(), key.hash()) : nullptr;
+    BOOST_ASSERT_MSG(member != nullptr, "key not exist, please check key spelling");
+    return member->value;
+}
+
+JsonType *JsonType::find(std::string_view key) {
+    if (type_ != EJsonType::JSON_OBJECT || !has_block()) return nullptr;
+    JsonMember *member = load<JsonObjectBlock *>()->find(key);
+    return member != nullptr ? &member->value : nullptr;
+}
+
+JsonType *JsonType::find(const JsonKey &key) {
+    if (type_ != EJsonType::JSON_OBJECT || !has_block()) return nullptr;
+    JsonMember *member = load<JsonObjectBlock *>()->find(key.view(), key.hash());
+    return member != nullptr ? &member->value : nullptr;
+}
+
+size_t JsonType::get_array_size() const {
+    JsonArrayBlock *block = array_block();
+    return block != nullptr ? block->size : 0;
 }
 
-JsonType &JsonType::get_object_element_by(const std::string &key) {
-    return impl_->get_object_element_by(key);
+size_t JsonType::get_object_size() const {
+    JsonObjectBlock *block = object_block();
+    return block != nullptr ? block->size : 0;
+}
+
+JsonMember &JsonType::get_object_member(size_t index) {
+    JsonObjectBlock *block = object_block();
+    BOOST_ASSERT_MSG(block != nullptr && index < block->size, "index out of json_object");
+    return block->members()[index];
 }
 
 bool JsonType::get_boolean() const {
-    return impl_->get_boolean();
+    BOOST_ASSERT_MSG(
+        type_ == EJsonType::JSON_TRUE || type_ == EJsonType::JSON_FALSE,
+        "type is not json_bool");
+    return load<bool>();
 }
 
 void *JsonType::get_null() const {
-    return impl_->get_null();
+    BOOST_ASSERT_MSG(type_ == EJsonType::JSON_NULL, "type is not json_null");
+    return nullptr;
+}
+
+bool JsonType::is_number() const {
+    return type_ == EJsonType::JSON_NUMBER || type_ == EJsonType::JSON_INT64 ||
+           type_ == EJsonType::JSON_UINT64;
 }
 
 double JsonType::get_number() const {
-    return impl_->get_number();
+    BOOST_ASSERT_MSG(is_number(), "type is not json_number");
+    switch (type_) {
+        case EJsonType::JSON_INT64:
+            return static_cast<double>(load<int64_t>());
+        case EJsonType::JSON_UINT64:
+            return static_cast<double>(load<uint64_t>());
+        default:
+            return load<double>();
+    }
+}
+
+int64_t JsonType::get_int64() const {
+    BOOST_ASSERT_MSG(type_ == EJsonType::JSON_INT64, "type is not json_int64");
+    return load<int64_t>();
+}
+
+// 不超过INT64_MAX的非负整数存在int64里，这里也能读
+uint64_t JsonType::get_uint64() const {
+    if (type_ == EJsonType::JSON_INT64) {
+        BOOST_ASSERT_MSG(load<int64_t>() >= 0, "json_int64 is negative");
+        return static_cast<uint64_t>(load<int64_t>());
+    }
+    BOOST_ASSERT_MSG(type_ == EJsonType::JSON_UINT64, "type is not json_uint64");
+    return load<uint64_t>();
 }
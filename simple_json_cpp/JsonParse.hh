@@ -1,14 +1,21 @@
 #pragma once
+#include "JsonArena.hh"
+#include "JsonHandler.hh"
+#include "JsonKeyPool.hh"
+#include "JsonNumber.hh"
+#include "JsonSimd.hh"
 #include "boost/assert.hpp"
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <iostream>
-#include <map>
-#include <queue>
-#include <stack>
+#include <memory>
+#include <memory_resource>
 #include <string>
-#include <unordered_map>
-#include <variant>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 enum JParseError {
@@ -31,6 +38,21 @@ enum JParseError {
   JSON_PARSE_ARRAY_MISS_COMMA,
   JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA,
   JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET,
+  // 按需解析时查找失败，见JsonOnDemand.hh
+  JSON_PARSE_OBJECT_KEY_NOT_EXIST,
+  JSON_PARSE_ARRAY_INDEX_OUT_OF_RANGE,
+  // handler的回调返回了false，见JsonHandler.hh
+  JSON_PARSE_TERMINATED,
+  // 容器嵌套超过了max_depth，见JsonParser::set_max_depth
+  JSON_PARSE_DEPTH_EXCEEDED,
+  // \u后面不是4个十六进制数
+  JSON_PARSE_INVALID_UNICODE_HEX,
+  // 高代理后面没有低代理，或者单独出现的低代理
+  JSON_PARSE_INVALID_UNICODE_SURROGATE,
+  // 字符串里不是合法的UTF-8，见JsonParser::set_validate_utf8
+  JSON_PARSE_INVALID_UTF8,
+  // 输入超过了tape的32位长度和跳转能表示的范围，见JsonTape.hh
+  JSON_PARSE_DOCUMENT_TOO_LARGE,
 };
 
 enum class EJsonType : char {
@@ -42,93 +64,59 @@ enum class EJsonType : char {
   JSON_STRING,
   JSON_ARRAY,
   JSON_OBJECT,
+  // 没有小数和指数部分的整数，见JsonNumber::parse
+  JSON_INT64,
+  JSON_UINT64,
 };
 
-class ParseNumHelper {
-  enum class ResNumStatus {
-    INTEGRAL,
-    FRACTIONAL,
-    EXPONENTIAL,
-  };
-
- public:
-  ParseNumHelper() { reset(); }
-  void reset() {
-    integral_part_ = 0;
-    fractional_part_ = 0;
-    exponential_part_ = 0;
-    integral_part_flag_ = 1;
-    exponential_part_flag_ = 1;
-    K = 0.1;
-
-    set_integral_status();
-  }
-  double get_num() const {
-    double res = integral_part_flag_ * (integral_part_ + fractional_part_) *
-                 pow(10, exponential_part_flag_ * exponential_part_);
-    return res;
-  }
-  void calc_number(int curr_num) {
-    switch (num_status_) {
-      case ResNumStatus::INTEGRAL:
-        integral_part_ = integral_part_ * 10 + curr_num;
-        break;
-      case ResNumStatus::FRACTIONAL:
-        fractional_part_ = fractional_part_ + (curr_num)*K;
-        K = K * 0.1;
-        break;
-      case ResNumStatus::EXPONENTIAL:
-        exponential_part_ = exponential_part_ * 10 + curr_num;
-        break;
-      default:
-        break;
-    }
-  }
-  void set_exponential_flag() { exponential_part_flag_ = -1; }
-  void set_integral_flag() { integral_part_flag_ = -1; }
-  void set_fractional_status() { num_status_ = ResNumStatus::FRACTIONAL; }
-  void set_exponential_status() { num_status_ = ResNumStatus::EXPONENTIAL; }
-
- private:
-  double K = 0.1;
-  void set_integral_status() { num_status_ = ResNumStatus::INTEGRAL; }
-  int integral_part_flag_{1};
-  int exponential_part_flag_{1};
-  double integral_part_{};
-  double fractional_part_{};
-  double exponential_part_{};
-  ResNumStatus num_status_{ResNumStatus::INTEGRAL};
-};
-
-
 class JsonParse;
-class JsonImpl;
+class JsonParser;
+class JsonDocument;
+class JsonTape;
+class JsonOnDemand;
+class JsonCursor;
+class JsonBatch;
+class JsonWriter;
+
+// 容器都走memory_resource，这样整棵树可以放进JsonDocument的arena里
+struct JsonStringBlock;
+struct JsonArrayBlock;
+struct JsonObjectBlock;
+struct JsonMember;
+class JsonKey;
+
+// 一个Json值，固定16字节：
+//   数字、布尔和不超过13字节的字符串直接存在值里
+//   原地解析或借用输入的字符串只存指针和长度
+//   更长的字符串、数组和对象存一个指针，指向的块里记着分配它的memory_resource
+// 数组的元素就是连续存放的JsonType，访问元素不用再多跳一次指针
 class JsonType{
-    friend  JsonParse;
+    friend  JsonParser;
+    friend  JsonDocument;
+    friend  JsonBatch;
+    friend  JsonWriter;
 public:
-    explicit JsonType(JsonImpl *impl = nullptr)
+    JsonType() = default;
+    ~JsonType()
     {
-        impl_.reset(impl);
+        if (storage_ == Storage::BLOCK) destroy();
     }
     JsonType(const JsonType&) = delete;
     void operator=(const JsonType&) = delete;
 
-    JsonType(JsonType&& rhs)
+    JsonType(JsonType&& rhs) noexcept
     {
-        std::swap(impl_, rhs.impl_);
+        take(rhs);
     }
-    JsonType & operator=(JsonType&& rhs)
+    JsonType & operator=(JsonType&& rhs) noexcept
     {
         if(this != &rhs)
         {
-            std::swap(impl_, rhs.impl_);
+            if (storage_ == Storage::BLOCK) destroy();
+            take(rhs);
         }
         return *this;
     }
-    void reset(JsonImpl *impl)
-    {
-        impl_.reset(impl);
-    }
 
     JsonType& operator[](size_t index);
     // 根据key来获得数据
@@ -136,197 +124,560 @@ public:
 
     std::string get_string();
 
+    // 不拷贝，原地解析时指向输入的buffer，短字符串指向值自己
+    [[nodiscard]] std::string_view get_string_view() const;
+
     JsonType& get_array_element_by(size_t index);
 
-    JsonType& get_object_element_by(const std::string &key);
+    // 按key查找对象的成员，不拷贝key，只探查一次；key不存在时断言失败
+    JsonType& get_object_element_by(std::string_view key);
+    JsonType& get_object_element_by(const JsonKey &key);
+    JsonType& operator[](std::string_view key) { return get_object_element_by(key); }
+    JsonType& operator[](const JsonKey &key) { return get_object_element_by(key); }
+    // 不是对象或者key不存在时返回nullptr
+    JsonType* find(std::string_view key);
+    JsonType* find(const JsonKey &key);
 
     [[nodiscard]] void *get_null() const;
 
     [[nodiscard]] bool get_boolean() const;
 
-    [[nodiscard]] double get_number() const;
-private:
-    std::unique_ptr<JsonImpl> impl_;
-};
+    // 三种数字类型都是number，整数也可以按double读取
+    [[nodiscard]] bool is_number() const;
 
-using JsonNullType = void *;
-using JsonBoolType = bool;
-using JsonNumberType = double;
-using JsonStringType = std::string;
+    [[nodiscard]] double get_number() const;
 
-using JsonArrayType = std::vector<JsonType>;
-using JsonObjectType =
-    std::unordered_map<JsonStringType, JsonType>;
+    [[nodiscard]] int64_t get_int64() const;
 
+    [[nodiscard]] uint64_t get_uint64() const;
 
-class JsonImpl {
- public:
-  friend class JsonParse;
+    [[nodiscard]] size_t get_array_size() const;
+    // 对象的成员按原文的顺序排列，重复的key都保留，按key查找时取最后一个
+    [[nodiscard]] size_t get_object_size() const;
+    JsonMember& get_object_member(size_t index);
+private:
+    // 值里的字节怎么解释，只有BLOCK需要释放
+    enum class Storage : uint8_t {
+        NONE,   // 标量，或者还没有建好的容器
+        SMALL,  // 短字符串，长度在bytes_的最后一个字节
+        VIEW,   // 指针 + 4字节长度，指向调用者的buffer
+        BLOCK,  // 指向JsonStringBlock/JsonArrayBlock/JsonObjectBlock
+        ARENA,  // 和BLOCK一样，但块在JsonParser的arena里，由arena回收，值不释放
+    };
+    static constexpr size_t kSmallSize = 13;
+    static constexpr size_t kMaxViewSize = UINT32_MAX;
 
-  using ObjectType =
-      std::variant<JsonNullType, JsonBoolType, JsonNumberType, JsonStringType,
-                   JsonArrayType, JsonObjectType>;
+    template <typename T>
+    T load(size_t offset = 0) const
+    {
+        T value;
+        memcpy(&value, bytes_ + offset, sizeof(T));
+        return value;
+    }
+    template <typename T>
+    void store(T value, size_t offset = 0)
+    {
+        memcpy(bytes_ + offset, &value, sizeof(T));
+    }
+    void take(JsonType &rhs)
+    {
+        memcpy(bytes_, rhs.bytes_, sizeof(bytes_));
+        storage_ = rhs.storage_;
+        type_ = rhs.type_;
+        rhs.detach();
+    }
+    // 不释放，树在arena里时由arena整块回收
+    void detach()
+    {
+        storage_ = Storage::NONE;
+        type_ = EJsonType::JSON_INVALID;
+    }
+    void destroy();
+    void free_block(std::vector<JsonType> &pending);
+    [[nodiscard]] bool has_block() const
+    {
+        return storage_ == Storage::BLOCK || storage_ == Storage::ARENA;
+    }
 
- private:
-  ObjectType obj{};
-  EJsonType type{EJsonType::JSON_INVALID};
+    // 下面由JsonParser调用，调用之前值必须是空的
+    template <typename T>
+    void set(EJsonType type, T value)
+    {
+        store(value);
+        type_ = type;
+    }
+    void set_string(std::string_view str, std::pmr::memory_resource *resource);
+    // 借用str，太长时拷贝
+    void set_borrowed(std::string_view str, std::pmr::memory_resource *resource);
+    // 一次分配size个元素，返回第一个元素
+    JsonType *set_array(size_t size, std::pmr::memory_resource *resource);
+    // 成员和key_bytes字节的key放在同一块里，返回第一个成员
+    JsonMember *set_object(size_t size, size_t key_bytes,
+                           std::pmr::memory_resource *resource);
+    [[nodiscard]] JsonArrayBlock *array_block() const;
+    [[nodiscard]] JsonObjectBlock *object_block() const;
+
+    alignas(8) char bytes_[14]{};
+    Storage storage_{Storage::NONE};
+    EJsonType type_{EJsonType::JSON_INVALID};
+};
 
- public:
-public:
+// 对象的一个成员，key指向对象块里的存储、借用的输入或者JsonKeyPool
+struct JsonMember {
+  const char *key_data{nullptr};
+  size_t key_size{0};
+  JsonType value;
 
-  explicit JsonImpl(EJsonType atype = EJsonType::JSON_INVALID) : type(atype) {}
-  JsonImpl(const JsonImpl &) = delete;
-  void operator=(const JsonImpl &) = delete;
-  JsonImpl(JsonImpl &&rhs) {
-    std::swap(obj, rhs.obj);
-    std::swap(type, rhs.type);
-  }
-  JsonImpl &operator=(JsonImpl &&rhs) {
-    swap(obj, rhs.obj);
-    type = rhs.type;
-    rhs.type = EJsonType ::JSON_INVALID;
-    return *this;
+  [[nodiscard]] std::string_view key() const {
+    return std::string_view(key_data, key_size);
   }
+};
 
+// 预先算好hash的key，反复用同一个key查找大量文档时不用每次重新计算
+//   static const JsonKey kUserId("user_id");
+//   record[kUserId].get_int64();
+class JsonKey {
  public:
-  // 根据key来获得数据
-  EJsonType get_type() const { return type; }
+  explicit JsonKey(std::string_view key)
+      : key_(key), hash_(std::hash<std::string_view>()(key)) {}
 
-  std::string get_string() {
-    BOOST_ASSERT_MSG(type == EJsonType::JSON_STRING, "type is not json_string");
-    return std::get<std::string>(obj);
-  }
+  [[nodiscard]] std::string_view view() const { return key_; }
+  [[nodiscard]] size_t hash() const { return hash_; }
 
-  JsonType& get_array_element_by(size_t index) {
-    BOOST_ASSERT_MSG(type == EJsonType::JSON_ARRAY, "type is not json_array");
-    auto &json_array = std::get<JsonArrayType>(obj);
-    BOOST_ASSERT_MSG(index < json_array.size(), "index out of json_array");
-    auto &value = json_array[index];
-    return value;
-  }
+ private:
+  std::string key_;
+  size_t hash_;
+};
 
-  JsonType& get_object_element_by(const std::string &key) {
-    BOOST_ASSERT_MSG(type == EJsonType::JSON_OBJECT, "type is not json_object");
-    auto &json_object = std::get<JsonObjectType>(obj);
-    BOOST_ASSERT_MSG(json_object.count(key) > 0,
-                     "key not exist, please check key spelling");
-    auto &value = json_object[key];
-    return value;
+// 块的头部，内容紧跟在头部后面
+struct JsonStringBlock {
+  std::pmr::memory_resource *resource;
+  size_t size;
+  [[nodiscard]] const char *data() const {
+    return reinterpret_cast<const char *>(this + 1);
   }
-
-  [[nodiscard]] void *get_null() const {
-    BOOST_ASSERT_MSG(type == EJsonType::JSON_NULL, "type is not json_null");
-    return std::get<void *>(obj);
+};
+struct JsonArrayBlock {
+  std::pmr::memory_resource *resource;
+  size_t size;
+  JsonType *elements() { return reinterpret_cast<JsonType *>(this + 1); }
+};
+// 成员不多时顺序查找，超过kLinearSize时第一次查找建一个开放寻址的hash索引，
+// 存成员下标加1，0表示空位
+struct JsonObjectBlock {
+  static constexpr size_t kLinearSize = 16;
+
+  std::pmr::memory_resource *resource;
+  size_t size;
+  size_t key_bytes;  // 成员后面拷贝进来的key的字节数
+  std::atomic<const uint32_t *> index{nullptr};
+
+  JsonMember *members() { return reinterpret_cast<JsonMember *>(this + 1); }
+  // hash是std::hash<std::string_view>()(key)，只在用到索引时才计算
+  [[nodiscard]] JsonMember *find(std::string_view key);
+  [[nodiscard]] JsonMember *find(std::string_view key, size_t hash);
+  // 索引的槽数，至少是成员数的2倍
+  [[nodiscard]] size_t index_capacity() const {
+    size_t capacity = 1;
+    while (capacity < size * 2) capacity <<= 1;
+    return capacity;
   }
-
-  [[nodiscard]] bool get_boolean() const {
-    BOOST_ASSERT_MSG(
-        type == EJsonType::JSON_TRUE || type == EJsonType::JSON_FALSE,
-        "type is not json_bool");
-    return std::get<bool>(obj);
+  [[nodiscard]] size_t block_bytes() const {
+    return sizeof(JsonObjectBlock) + size * sizeof(JsonMember) + key_bytes;
   }
 
-  [[nodiscard]] double get_number() const {
-    BOOST_ASSERT_MSG(type == EJsonType::JSON_NUMBER, "type is not json_number");
-    return std::get<double>(obj);
-  }
+ private:
+  const uint32_t *build_index();
+  JsonMember *find_linear(std::string_view key);
+  JsonMember *find_indexed(std::string_view key, size_t hash);
 };
 
+// 一次解析得到的整棵树，所有节点、字符串和容器都分配在自己的arena里，
+// 析构时不逐个释放节点，而是整块归还arena
+class JsonDocument {
+    friend JsonParser;
+public:
+    explicit JsonDocument(size_t block_size = JsonArena::kDefaultBlockSize)
+        : arena_(block_size)
+    {
+    }
+    JsonDocument(const JsonDocument&) = delete;
+    void operator=(const JsonDocument&) = delete;
+    ~JsonDocument()
+    {
+        root_.detach();
+    }
+
+    JsonType& root() { return root_; }
+    [[nodiscard]] const JsonArena& arena() const { return arena_; }
+
+    // 丢掉整棵树，树里的值全部由arena回收，不需要调用析构
+    // arena留下最大的一块，反复解析到同一个doc时不用重新申请
+    void clear()
+    {
+        root_.detach();
+        arena_.reset();
+        shard_arenas_.clear();
+    }
+private:
+    JsonArena arena_;
+    // parse_parallel时各个线程用的arena
+    std::vector<std::unique_ptr<JsonArena>> shard_arenas_;
+    JsonType root_;
+};
+
+// 解析器：游标、字符串的scratch和容器栈都是对象自己的，多次parse之间复用，
+// 一个线程反复解析大量小文档时不需要每次重新申请
+// 不能在多个线程之间共享，每个线程用自己的JsonParser
+class JsonParser {
+  friend JsonCursor;
+  template <typename Handler>
+  friend class JsonStreamParser;
 
-class JsonParse {
  public:
-  // 将Json文本解析成Json树
+  // use_arena为true时，parse(str)、parse_insitu(buf, n)、parse_borrowed(str)
+  // 返回的树分配在parser自己的arena里，每次parse时回收上一次的树(保留申请过的内存)，
+  // 所以返回的树只在下一次parse之前可以访问
+  // 返回的根不拥有arena里的块，和JsonDocument的根一样析构时什么都不做，
+  // 比parser活得久或者在下一次parse之后析构都是安全的；不要把子节点move出来
+  explicit JsonParser(bool use_arena = false) : use_arena_(use_arena) {}
+  JsonParser(const JsonParser &) = delete;
+  void operator=(const JsonParser &) = delete;
+
+  // 解析不递归，嵌套深度不受线程栈的限制，max_depth只是拒绝恶意的深层嵌套，
+  // 超过时返回JSON_PARSE_DEPTH_EXCEEDED，容器栈最多占O(max_depth)的内存
+  static constexpr size_t kDefaultMaxDepth = 1024;
+  void set_max_depth(size_t depth) { max_depth_ = depth; }
+  [[nodiscard]] size_t max_depth() const { return max_depth_; }
+  // 设置之后DOM的key都放进pool(不论是否借用输入)，文档里只保存指向pool的view
+  // pool为空时恢复成每个文档自己保存key，见JsonKeyPool.hh
+  void set_key_pool(JsonKeyPool *pool) {
+    key_pool_ = pool;
+    key_cache_.assign(pool != nullptr ? kKeyCacheSize : 0, std::string_view());
+  }
+  [[nodiscard]] JsonKeyPool *key_pool() const { return key_pool_; }
+  // 检查字符串和key里的原始字节是否是合法的UTF-8，不合法时返回JSON_PARSE_INVALID_UTF8
+  // 在找字符串结束位置的同时做，字节还在cache里，不需要对整个输入再扫一遍
+  void set_validate_utf8(bool validate) { validate_utf8_ = validate; }
+  [[nodiscard]] bool validate_utf8() const { return validate_utf8_; }
+
+  // 将Json文本解析成Json树，语法是 ws value ws  , ws指空白符
+  std::pair<JsonType, JParseError> parse(std::string_view str) {
+    reset_context(str.data(), str.size(), tree_resource());
+    return parse_tree();
+  }
+  // 解析到doc中，doc里原来的树会被丢掉
+  JParseError parse(std::string_view str, JsonDocument &doc) {
+    doc.clear();
+    reset_context(str.data(), str.size(), &doc.arena_);
+    return parse_root(doc.root_);
+  }
+  // 多线程解析一个很大的顶层数组，元素分给threads个线程，threads为0时用全部核
+  // 结果和错误码与parse(str, doc)一样，实现在JsonParallel.cc
+  static JParseError parse_parallel(std::string_view str, JsonDocument &doc,
+                                    size_t threads = 0);
+  // 原地解析：字符串和key直接在buf里反转义，值里只保存指向buf的string_view，
+  // 省掉每个字符串的分配和拷贝
+  // buf会被改写，并且必须比解析出来的树活得久
+  std::pair<JsonType, JParseError> parse_insitu(char *buf, size_t n) {
+    reset_context(buf, n, tree_resource());
+    insitu_ = buf;
+    auto res = parse_tree();
+    insitu_ = nullptr;
+    return res;
+  }
+  JParseError parse_insitu(char *buf, size_t n, JsonDocument &doc) {
+    doc.clear();
+    reset_context(buf, n, &doc.arena_);
+    insitu_ = buf;
+    JParseError ret = parse_root(doc.root_);
+    insitu_ = nullptr;
+    return ret;
+  }
+  // 借用输入：没有转义的字符串和key只保存指向str的string_view，有转义的照常解码
+  // str必须比解析出来的树活得久
+  std::pair<JsonType, JParseError> parse_borrowed(std::string_view str) {
+    reset_context(str.data(), str.size(), tree_resource());
+    borrow_ = true;
+    auto res = parse_tree();
+    borrow_ = false;
+    return res;
+  }
+  JParseError parse_borrowed(std::string_view str, JsonDocument &doc) {
+    doc.clear();
+    reset_context(str.data(), str.size(), &doc.arena_);
+    borrow_ = true;
+    JParseError ret = parse_root(doc.root_);
+    borrow_ = false;
+    return ret;
+  }
+  // 解析成tape，见JsonTape.hh
+  JParseError parse(std::string_view str, JsonTape &tape);
+  // 按需解析，只记下输入，见JsonOnDemand.hh
+  JParseError parse(std::string_view str, JsonOnDemand &doc);
+  // 并行解析NDJSON，每个非空行一条记录，threads为0时用全部核
+  // 返回出错的记录数，见JsonBatch.hh
+  static size_t parse_many(std::string_view input, JsonBatch &batch,
+                           size_t threads = 0);
+  // 不建树，按文档顺序把事件交给handler，见JsonHandler.hh
+  template <typename Handler,
+            typename = std::enable_if_t<std::is_class_v<Handler>>>
+  JParseError parse(std::string_view str, Handler &handler) {
+    reset_context(str.data(), str.size(), std::pmr::new_delete_resource());
+    return parse_events(handler);
+  }
 
-  static std::pair<JsonType, JParseError> parse(std::string_view str) {
-    return parse((const char *)str.data(), str.size());
+ private:
+  std::pmr::memory_resource *tree_resource() {
+    if (!use_arena_) return std::pmr::new_delete_resource();
+    arena_.reset();
+    return &arena_;
   }
-  // 这里的语法是 ws value ws  , ws指空白符
-  static std::pair<JsonType, JParseError> parse(const char *context,
-                                                   int size) {
+  void reset_context(const char *context, size_t size,
+                            std::pmr::memory_resource *resource) {
+    assert(context);
     context_ = context;
     size_ = size;
     curr_index_ = 0;
-    assert(context);
-    // strip space
-    skip_space();
-
-    std::unique_ptr<JsonImpl> curr_value = std::make_unique<JsonImpl>();
-    JParseError ret;
-    if ((ret = parse_value(*curr_value)) == JParseError::JSON_PARSE_OK) {
-      skip_space();
-      if (curr_index_ != size_)
-        return {JsonType{}, JParseError::JSON_PARSE_ROOT_NOT_SINGULAR};
-    }
+    resource_ = resource;
+    insitu_ = nullptr;
+    borrow_ = false;
+  }
+  // 返回给调用者的树，在parser的arena里时根不拥有它的块
+  std::pair<JsonType, JParseError> parse_tree() {
     std::pair<JsonType, JParseError> res;
-    res.first.reset(curr_value.release());
-    res.second = ret;
+    res.second = parse_root(res.first);
+    if (use_arena_ && res.first.storage_ == JsonType::Storage::BLOCK)
+      res.first.storage_ = JsonType::Storage::ARENA;
     return res;
   }
-
-  // 生成器
-    static std::string stringfy(const JsonType& json_t)
-    {
-        switch (json_t.get_type()) {
-            case EJsonType::JSON_NULL:
-                return "null";
-                break;
-            case EJsonType::JSON_TRUE:
-                return "true";
-                break;
-            case EJsonType::JSON_FALSE:
-                return "false";
-                break;
-            case EJsonType::JSON_NUMBER:
-                break;
-            case EJsonType::JSON_ARRAY:
-                break;
-            case EJsonType::JSON_OBJECT:
-                break;
-            default:
-                break;
-        }
+  JParseError parse_root(JsonType &root) {
+    root = JsonType();
+    DomBuilder builder(*this, root);
+    return parse_events(builder);
+  }
+  // 把事件接到JsonType树上，DOM的解析就是一个handler
+  // 所有打开的容器共用parser里的一个子节点栈(类似leptjson.c的lept_context_push)，
+  // 容器结束时按确切的个数一次建好，子节点从栈上搬进去，不需要逐个扩容
+  // 出错时栈上的子节点由析构函数释放
+  class DomBuilder {
+   public:
+    // 打开的容器在栈上的下标(根节点是kRoot)，以及它的子节点、key和key的文本在栈上的起点
+    struct Frame {
+      size_t index;
+      size_t values;
+      size_t keys;
+      size_t key_bytes;
+    };
+    // 借用的key直接指向原处，其余的key先拷贝进key_bytes_
+    struct Key {
+      const char *borrowed;
+      size_t offset;
+      size_t size;
+    };
+    static constexpr size_t kRoot = SIZE_MAX;
+
+    DomBuilder(JsonParser &parser, JsonType &root)
+        : parser_(parser),
+          root_(&root),
+          stack_(parser.dom_stack_),
+          values_(parser.dom_values_),
+          keys_(parser.dom_keys_),
+          key_bytes_(parser.dom_key_bytes_) {
+      stack_.clear();
     }
+    // 子节点可能在doc的arena里，不能留到下一次parse
+    ~DomBuilder() {
+      values_.clear();
+      keys_.clear();
+      key_bytes_.clear();
+    }
+    DomBuilder(const DomBuilder &) = delete;
+    void operator=(const DomBuilder &) = delete;
 
-private:
-    static std::string stringfy_array(JsonArrayType & json_array)
-    {
-
+    bool null() {
+      at(next_index()).set(EJsonType::JSON_NULL, nullptr);
+      return true;
+    }
+    bool boolean(bool b) {
+      at(next_index()).set(b ? EJsonType::JSON_TRUE : EJsonType::JSON_FALSE, b);
+      return true;
+    }
+    bool number(double d) {
+      at(next_index()).set(EJsonType::JSON_NUMBER, d);
+      return true;
+    }
+    bool int64(int64_t i) {
+      at(next_index()).set(EJsonType::JSON_INT64, i);
+      return true;
+    }
+    bool uint64(uint64_t u) {
+      at(next_index()).set(EJsonType::JSON_UINT64, u);
+      return true;
+    }
+    bool string(std::string_view str) {
+      JsonType &value = at(next_index());
+      if (borrowable(str))
+        value.set_borrowed(str, parser_.resource_);
+      else
+        value.set_string(str, parser_.resource_);
+      return true;
+    }
+    // 容器的块等到结束时才知道大小，这里只记下类型
+    bool start_object() {
+      size_t index = next_index();
+      at(index).type_ = EJsonType::JSON_OBJECT;
+      push_frame(index);
+      return true;
+    }
+    bool key(std::string_view str) {
+      if (parser_.key_pool_ != nullptr) {
+        std::string_view interned = parser_.intern_key(str);
+        keys_.push_back(Key{interned.data(), 0, interned.size()});
+      } else if (borrowable(str)) {
+        keys_.push_back(Key{str.data(), 0, str.size()});
+      } else {
+        keys_.push_back(Key{nullptr, key_bytes_.size(), str.size()});
+        key_bytes_.append(str.data(), str.size());
+      }
+      return true;
+    }
+    // 成员和这个对象自己拷贝的key一起放进一个块
+    bool end_object(size_t) {
+      Frame frame = stack_.back();
+      stack_.pop_back();
+      size_t size = values_.size() - frame.values;
+      size_t bytes = key_bytes_.size() - frame.key_bytes;
+      JsonMember *members =
+          at(frame.index).set_object(size, bytes, parser_.resource_);
+      char *text = reinterpret_cast<char *>(members + size);
+      if (bytes != 0) memcpy(text, key_bytes_.data() + frame.key_bytes, bytes);
+      for (size_t i = 0; i < size; i++) {
+        const Key &key = keys_[frame.keys + i];
+        members[i].key_data = key.borrowed != nullptr
+                                  ? key.borrowed
+                                  : text + (key.offset - frame.key_bytes);
+        members[i].key_size = key.size;
+        members[i].value = std::move(values_[frame.values + i]);
+      }
+      values_.resize(frame.values);
+      keys_.resize(frame.keys);
+      key_bytes_.resize(frame.key_bytes);
+      return true;
+    }
+    bool start_array() {
+      size_t index = next_index();
+      at(index).type_ = EJsonType::JSON_ARRAY;
+      push_frame(index);
+      return true;
+    }
+    bool end_array(size_t) {
+      Frame frame = stack_.back();
+      stack_.pop_back();
+      size_t size = values_.size() - frame.values;
+      JsonType *elements = at(frame.index).set_array(size, parser_.resource_);
+      for (size_t i = 0; i < size; i++)
+        elements[i] = std::move(values_[frame.values + i]);
+      values_.resize(frame.values);
+      return true;
     }
-    static std::string stringfy_object(JsonObjectType & json_object)
-    {
 
+   private:
+    // 借用输入或原地解析时，落在输入里的字符串只保存view
+    bool borrowable(std::string_view str) const {
+      return (parser_.borrow_ || parser_.insitu_ != nullptr) &&
+             str.data() >= parser_.context_ &&
+             str.data() + str.size() <= parser_.context_ + parser_.size_;
     }
-public:
-private:
-    // 跳过空格，到一个非空格字符
-  static void skip_space() {
-    while (curr_index_ != size_ && isspace(context_[curr_index_])) {
-      curr_index_++;
+    void push_frame(size_t index) {
+      stack_.push_back(
+          Frame{index, values_.size(), keys_.size(), key_bytes_.size()});
+    }
+    // 栈会扩容，打开的容器只能记下标
+    JsonType &at(size_t index) {
+      return index == kRoot ? *root_ : values_[index];
+    }
+    size_t next_index() {
+      if (stack_.empty()) return kRoot;
+      values_.emplace_back();
+      return values_.size() - 1;
+    }
+
+    JsonParser &parser_;
+    JsonType *root_;
+    std::vector<Frame> &stack_;
+    std::vector<JsonType> &values_;
+    std::vector<Key> &keys_;
+    std::string &key_bytes_;
+  };
+  // 最近用过的key按hash缓存在parser里，命中时不用去池里加锁查找
+  static constexpr size_t kKeyCacheSize = 256;
+  std::string_view intern_key(std::string_view str) {
+    size_t hash = std::hash<std::string_view>()(str);
+    std::string_view &slot = key_cache_[hash % kKeyCacheSize];
+    if (slot.data() == nullptr || slot != str)
+      slot = key_pool_->intern(str, hash);
+    return slot;
+  }
+  // 事件引擎，DOM、tape和用户的handler共用
+  // 语法是 ws value ws，错误码与原来的parse_value/parse_array/parse_object一致
+  // 不递归：打开的容器记在frames_里，嵌套多深都只占frames_的空间
+  template <typename Handler>
+  JParseError parse_events(Handler &handler) {
+    frames_.clear();
+    skip_space();
+    JParseError ret = emit_document(handler);
+    if (ret == JSON_PARSE_OK) {
+      skip_space();
+      if (curr_index_ != size_) return JSON_PARSE_ROOT_NOT_SINGULAR;
     }
+    return ret;
+  }
+  static JParseError handler_result(bool ok) {
+    return ok ? JSON_PARSE_OK : JSON_PARSE_TERMINATED;
+  }
+  // 跳过空白，到一个非空白字符
+  void skip_space() {
+    curr_index_ =
+        JsonSimd::skip_whitespace(context_ + curr_index_, context_ + size_) - context_;
+  }
+  // 一个打开的容器，type是'['或'{'
+  struct Frame {
+    char type;
+    size_t count;
+  };
+  // 容器出错时整个值都报成它缺少值/成员，和递归时外层逐层改写的结果相同：
+  // 最外层容器里的错误最终都变成最外层容器的错误码
+  JParseError frame_failed(JParseError err) const {
+    if (frames_.size() <= 1) return err;
+    return frames_.front().type == '[' ? JSON_PARSE_ARRAY_MISS_VALUE
+                                       : JSON_PARSE_OBJECT_MISS_MEMBER;
+  }
+  // 值本身不合法，先报成所在容器缺少值/成员
+  JParseError value_failed(JParseError err) const {
+    if (frames_.empty()) return err;
+    return frame_failed(frames_.back().type == '['
+                            ? JSON_PARSE_ARRAY_MISS_VALUE
+                            : JSON_PARSE_OBJECT_MISS_MEMBER);
   }
-  static JParseError parse_value(JsonImpl &value) {
-    static const int NULL_LENGTH = 4;
-    static const int TRUE_LENGTH = 4;
-    static const int FALSE_LENGTH = 5;
+  // 标量直接交给handler，容器只压栈并回调start，返回后由emit_document继续
+  template <typename Handler>
+  JParseError emit_value(Handler &handler) {
     if (curr_index_ == size_) return JSON_PARSE_EXPECT_VALUE;
     JParseError err;
     switch (context_[curr_index_]) {
       case 'n':
-        err = parse_value_compare_with("null", NULL_LENGTH);
-        value.type = EJsonType::JSON_NULL;
-        value.obj = nullptr;
-        return err;
-
+        if ((err = parse_value_compare_with("null", 4)) != JSON_PARSE_OK)
+          return err;
+        return handler_result(handler.null());
       case 't':
-        err = parse_value_compare_with("true", TRUE_LENGTH);
-        value.type = EJsonType::JSON_TRUE;
-        value.obj = true;
-        return err;
+        if ((err = parse_value_compare_with("true", 4)) != JSON_PARSE_OK)
+          return err;
+        return handler_result(handler.boolean(true));
       case 'f':
-        err = parse_value_compare_with("false", FALSE_LENGTH);
-        value.type = EJsonType::JSON_FALSE;
-        value.obj = false;
-        return err;
+        if ((err = parse_value_compare_with("false", 5)) != JSON_PARSE_OK)
+          return err;
+        return handler_result(handler.boolean(false));
       case '\0':
         return JSON_PARSE_EXPECT_VALUE;
       case '-':
@@ -339,245 +690,126 @@ private:
       case '6':
       case '7':
       case '8':
-      case '9':
-        return parse_number(value);
-      case '\"':
-        return parse_string(value);
+      case '9': {
+        JsonNumber::Value num;
+        if ((err = parse_number_raw(num)) != JSON_PARSE_OK) return err;
+        switch (num.kind) {
+          case JsonNumber::Kind::INT64:
+            return handler_result(handler.int64(num.i));
+          case JsonNumber::Kind::UINT64:
+            return handler_result(handler.uint64(num.u));
+          default:
+            return handler_result(handler.number(num.d));
+        }
+      }
+      case '\"': {
+        std::string_view str;
+        if ((err = parse_string_view(str)) != JSON_PARSE_OK) return err;
+        return handler_result(handler.string(str));
+      }
       case '{':
-        return parse_object(value);
-      case '[':
-        return parse_array(value);
+      case '[': {
+        if (frames_.size() >= max_depth_) return JSON_PARSE_DEPTH_EXCEEDED;
+        char type = context_[curr_index_++];
+        bool ok = type == '[' ? handler.start_array() : handler.start_object();
+        if (!ok) return JSON_PARSE_TERMINATED;
+        frames_.push_back(Frame{type, 0});
+        return JSON_PARSE_OK;
+      }
       default:
         return JSON_PARSE_INVALID_VALUE;
     }
   }
-  // 根据状态转移图，很容易做number的解析
-  //
-  enum class NumberState {
-    NEGATIVE,
-    POSITIVE,
-    ZERO,
-    DIGIT1_9,
-    DIGIT,
-    STATUS_E,
-    POINT,
-    E_AFTER_N,
-    START,
-    INVALID,
-  };
-  static int get_state_index(char x) {
-    if (x > '0' && x <= '9') return 3;
-    switch (x) {
-      case '-':
-        return 0;
-      case '+':
-        return 1;
-      case '0':
-        return 2;
-      case 'e':
-      case 'E':
-        return 5;
-      case '.':
-        return 6;
-      default:
-        return -1;
-    }
-  }
-  using TableType = std::map<NumberState, std::array<NumberState, 8>>;
-  static TableType get_status_table() {
-    static TableType table = {
-        /*0 stands for NEGATIVE */
-        /*1 stands for POSITIVE */
-        /*2 stands for ZERO */
-        /*3 stands for DIGIT1_9*/
-        /*4 stands for DIGIT*/
-        /*5 stands for STATUS_E*/
-        /*6 stands for POINT*/
-        /*7 stands for E_A_N*/
-        {NumberState::START,
-         {NumberState::NEGATIVE, NumberState::INVALID, NumberState::ZERO,
-          NumberState::DIGIT1_9, NumberState::INVALID, NumberState::INVALID,
-          NumberState::INVALID, NumberState::INVALID}},
-        {NumberState::NEGATIVE,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::ZERO,
-          NumberState::DIGIT1_9, NumberState::INVALID, NumberState::INVALID,
-          NumberState::INVALID, NumberState::INVALID}},
-        {NumberState::POSITIVE,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
-          NumberState::INVALID, NumberState::INVALID}},
-        {NumberState::ZERO,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::STATUS_E,
-          NumberState::POINT, NumberState::INVALID}},
-        {NumberState::DIGIT1_9,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::STATUS_E,
-          NumberState::POINT, NumberState::INVALID}},
-        {NumberState::DIGIT,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::STATUS_E,
-          NumberState::POINT, NumberState::INVALID}},
-        {NumberState::STATUS_E,
-         {NumberState::E_AFTER_N, NumberState::POSITIVE, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
-          NumberState::INVALID, NumberState::INVALID}},
-        {NumberState::POINT,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
-          NumberState::INVALID, NumberState::INVALID}},
-        {NumberState::E_AFTER_N,
-         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
-          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
-          NumberState::INVALID, NumberState::INVALID}},
-    };
-    return table;
-  }
-  // 解析数组
-  static JParseError parse_array(JsonImpl &value) {
-    BOOST_ASSERT(context_[curr_index_] == '[');
+  // 关闭栈顶容器，curr_index_指向右括号
+  template <typename Handler>
+  bool close_frame(Handler &handler) {
     curr_index_++;
-    skip_space();
-    value.obj.emplace<JsonArrayType>(JsonArrayType{});
-    if (context_[curr_index_] == ']') {
-      if (context_[curr_index_] == '}') {
-        curr_index_++;
-        return JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA;
-      }
-      value.type = EJsonType::JSON_ARRAY;
-      curr_index_++;
-      return JParseError::JSON_PARSE_OK;
-    }
-
-    enum class JParseArrayStatus {
-      EXPECTED_VALUE,
-      EXPECTED_COMMA,
-      EXPECTED_BRAKCET,
-    } status;
-
-    auto &json_array = std::get<JsonArrayType>(value.obj);
-    status = JParseArrayStatus::EXPECTED_VALUE;
+    Frame frame = frames_.back();
+    frames_.pop_back();
+    return frame.type == '[' ? handler.end_array(frame.count)
+                             : handler.end_object(frame.count);
+  }
+  // 一个循环处理整个文档，每次迭代解析一个值(或者打开一个容器)，
+  // 再根据栈顶容器处理后面的逗号、右括号以及下一个key
+  template <typename Handler>
+  JParseError emit_document(Handler &handler) {
     JParseError err;
-
-    std::unique_ptr array_obj(std::make_unique<JsonImpl>());
-    int array_obj_num = 0;
-
-    // 为什么要用一个队列？因为如果解析失败的话，会发生内存泄漏
-    std::queue<std::unique_ptr<JsonImpl>> local_queue;
-    for (; curr_index_ != size_;) {
-      switch (status) {
-        case JParseArrayStatus::EXPECTED_VALUE:
-          if (context_[curr_index_] == ']') {
-            curr_index_++;
-            return JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA;
-          }
-          if ((err = parse_value(*array_obj)) != JSON_PARSE_OK) {
-            return JSON_PARSE_ARRAY_MISS_VALUE;
-          }
+    for (;;) {
+      size_t depth = frames_.size();
+      if ((err = emit_value(handler)) != JSON_PARSE_OK) {
+        if (err == JSON_PARSE_TERMINATED || err == JSON_PARSE_DEPTH_EXCEEDED)
+          return err;
+        return value_failed(err);
+      }
+      if (frames_.size() > depth) {
+        // 刚打开一个容器，处理空容器和第一个成员
+        skip_space();
+        char close = frames_.back().type == '[' ? ']' : '}';
+        if (curr_index_ == size_ || context_[curr_index_] != close) {
+          if ((err = next_member(handler)) != JSON_PARSE_OK) return err;
+          continue;
+        }
+        if (!close_frame(handler)) return JSON_PARSE_TERMINATED;
+      }
+      // 一个值结束了，逐层处理后面的逗号和右括号
+      for (;;) {
+        if (frames_.empty()) return JSON_PARSE_OK;
+        Frame &frame = frames_.back();
+        frame.count++;
+        skip_space();
+        bool array = frame.type == '[';
+        if (curr_index_ == size_)
+          return frame_failed(array ? JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET
+                                    : JSON_PARSE_OBJECT_MISS_RIGHT_BRACKET);
+        char c = context_[curr_index_];
+        if (c == ',') {
+          curr_index_++;
           skip_space();
-          status = JParseArrayStatus::EXPECTED_COMMA;
-          break;
-        case JParseArrayStatus::EXPECTED_COMMA:
-          if (context_[curr_index_] == ',') {
-            // 将值插入到array中
-            array_obj_num++;
-            local_queue.push(std::move(array_obj));
-            status = JParseArrayStatus::EXPECTED_VALUE;
-
-            // 重置array_obj
-            array_obj = std::move(std::make_unique<JsonImpl>());
-
-            curr_index_++;
-            skip_space();
-          } else if (context_[curr_index_] == ']') {
-            array_obj_num++;
-            local_queue.push(std::move(array_obj));
-            status = JParseArrayStatus::EXPECTED_BRAKCET;
-          } else {
-            return JSON_PARSE_ARRAY_MISS_COMMA;
-          }
+          if ((err = next_member(handler)) != JSON_PARSE_OK) return err;
           break;
-        case JParseArrayStatus::EXPECTED_BRAKCET:
-          if (context_[curr_index_] == ']') {
-            assert(array_obj_num == local_queue.size());
-            curr_index_++;
-
-            while (!local_queue.empty()) {
-              json_array.emplace_back(local_queue.front().release());
-              local_queue.pop();
-            }
-
-            value.type = EJsonType::JSON_ARRAY;
-            return JSON_PARSE_OK;
-          } else {
-            return JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET;
-          }
-        default:
-          BOOST_ASSERT(false);  // 不可能情况
+        }
+        if (c != (array ? ']' : '}'))
+          return frame_failed(array ? JSON_PARSE_ARRAY_MISS_COMMA
+                                    : JSON_PARSE_OBJECT_MISS_COMMA);
+        if (!close_frame(handler)) return JSON_PARSE_TERMINATED;
       }
     }
-    switch (status) {
-      case JParseArrayStatus::EXPECTED_VALUE:
-        return JSON_PARSE_ARRAY_MISS_VALUE;
-      case JParseArrayStatus::EXPECTED_COMMA:
-        [[fallthrough]];
-      case JParseArrayStatus::EXPECTED_BRAKCET:
-        return JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET;
-    }
-  }
-
-  static JParseError parse_number(JsonImpl &value) {
-    NumberState prev_state = NumberState::START;
-    NumberState curr_state;
-    ParseNumHelper parseNumHelper;
-    bool is_end = false;
-    // 状态遇到不同的值发生不同的变化
-    // 结束条件为，curr_index_走到头， 或者get_state_index收到不合理的字符
-    for (; curr_index_ != size_; curr_index_++) {
-      char curr_char = context_[curr_index_];
-      auto index_of_curr_char = get_state_index(curr_char);
-      if (index_of_curr_char == -1) /*代表收到不在状态图的字符*/
-      {
-        break;
+  }
+  // 容器里下一个值之前的部分：数组没有，对象是 key ws : ws
+  template <typename Handler>
+  JParseError next_member(Handler &handler) {
+    if (frames_.back().type == '[') {
+      if (curr_index_ == size_) return frame_failed(JSON_PARSE_ARRAY_MISS_VALUE);
+      if (context_[curr_index_] == ']') {
+        curr_index_++;
+        return frame_failed(JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA);
       }
-      curr_state = get_status_table().at(prev_state).at(index_of_curr_char);
-      prev_state = curr_state;
-      switch (curr_state) {
-        case NumberState::INVALID:
-          return JParseError::JSON_PARSE_INVALID_VALUE;
-        case NumberState::POSITIVE:
-          continue;
-        case NumberState::NEGATIVE:
-          parseNumHelper.set_integral_flag();
-          break;
-        case NumberState::E_AFTER_N:
-          parseNumHelper.set_exponential_flag();
-          break;
-        case NumberState::ZERO:
-          [[fallthrough]];
-        case NumberState::DIGIT1_9:
-          [[fallthrough]];
-        case NumberState::DIGIT:
-          // 这里要计算三部分的东西
-          parseNumHelper.calc_number(curr_char - '0');
-          break;
-        case NumberState::POINT:
-          parseNumHelper.set_fractional_status();
-          break;
-        case NumberState::STATUS_E:
-          parseNumHelper.set_exponential_status();
-          break;
-        case NumberState::START:
-          break;
-      }  // end switch
-    }    // end for
-    if (curr_state == NumberState::DIGIT1_9 ||
-        curr_state == NumberState::ZERO || curr_state == NumberState::DIGIT) {
-      value.obj = parseNumHelper.get_num();
-      value.type = EJsonType::JSON_NUMBER;
       return JSON_PARSE_OK;
     }
-    return JSON_PARSE_INVALID_VALUE;
+    if (curr_index_ == size_) return frame_failed(JSON_PARSE_OBJECT_MISS_KEY);
+    if (context_[curr_index_] == '}') {
+      curr_index_++;
+      return frame_failed(JSON_PARSE_OBJECT_LAST_MUST_NOT_COMMA);
+    }
+    std::string_view key;
+    if (parse_string_view(key) != JSON_PARSE_OK)
+      return frame_failed(JSON_PARSE_OBJECT_MISS_KEY);
+    if (!handler.key(key)) return JSON_PARSE_TERMINATED;
+    skip_space();
+    if (curr_index_ == size_ || context_[curr_index_++] != ':')
+      return frame_failed(JSON_PARSE_OBJECT_MISS_COLON);
+    skip_space();
+    if (curr_index_ == size_) return frame_failed(JSON_PARSE_OBJECT_MISS_MEMBER);
+    return JSON_PARSE_OK;
+  }
+  // 状态机只负责确定数字的边界和合法性，数值由JsonNumber一次算出
+  JParseError parse_number_raw(JsonNumber::Value &num) {
+    const char *first = context_ + curr_index_;
+    const char *last = JsonNumber::scan(first, context_ + size_);
+    if (last == nullptr) return JSON_PARSE_INVALID_VALUE;
+    num = JsonNumber::parse(first, last);
+    curr_index_ = last - context_;
+    return JSON_PARSE_OK;
   }
   // 解析字符串，注意转义字符的处理
   /*
@@ -589,9 +821,11 @@ private:
      %x6E /          ; n    line feed       U+000A
      %x72 /          ; r    carriage return U+000D
      %x74 /          ; t    tab             U+0009
+     %x75 4HEXDIG    ; uXXXX                U+XXXX
   */
 
-  static bool parse_zhuanyi_string(std::string &str, char next_char) {
+  template <typename String>
+  static bool parse_zhuanyi_string(String &str, char next_char) {
     switch (next_char) {
       case 0x22 /*	"	*/:
       case 0x5c /*	\	*/:
@@ -618,177 +852,266 @@ private:
     }
     return true;
   }
-  // 解析Json对象
-  static JParseError parse_object(JsonImpl &value) {
-    // expect
-    assert(context_[curr_index_] == '{');
-    curr_index_++;
-    skip_space();
-    value.obj.emplace<JsonObjectType>(JsonObjectType{});
-    if (context_[curr_index_] == '}') {
-      curr_index_++;
-      value.type = EJsonType::JSON_OBJECT;
+  // 读p开始的4个十六进制数
+  static bool parse_hex4(const char *p, const char *end, unsigned &u) {
+    if (end - p < 4) return false;
+    u = 0;
+    for (int i = 0; i < 4; i++) {
+      char ch = p[i];
+      u <<= 4;
+      if (ch >= '0' && ch <= '9')
+        u |= ch - '0';
+      else if (ch >= 'A' && ch <= 'F')
+        u |= ch - ('A' - 10);
+      else if (ch >= 'a' && ch <= 'f')
+        u |= ch - ('a' - 10);
+      else
+        return false;
+    }
+    return true;
+  }
+  static bool is_high_surrogate(unsigned u) { return u >= 0xD800 && u <= 0xDBFF; }
+  static bool is_low_surrogate(unsigned u) { return u >= 0xDC00 && u <= 0xDFFF; }
+  template <typename String>
+  static void encode_utf8(String &str, unsigned u) {
+    if (u <= 0x7F) {
+      str.push_back(static_cast<char>(u));
+    } else if (u <= 0x7FF) {
+      str.push_back(static_cast<char>(0xC0 | (u >> 6)));
+      str.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+    } else if (u <= 0xFFFF) {
+      str.push_back(static_cast<char>(0xE0 | (u >> 12)));
+      str.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+    } else {
+      assert(u <= 0x10FFFF);
+      str.push_back(static_cast<char>(0xF0 | (u >> 18)));
+      str.push_back(static_cast<char>(0x80 | ((u >> 12) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+    }
+  }
+  // p指向\u后面的十六进制数，代理对连同后面的\uXXXX一起解码成UTF-8追加到str，
+  // next返回转义之后的位置
+  // 解码结果(最多4字节)比原文(6或12字节)短，原地解析时也不会写过读的位置
+  template <typename String>
+  static JParseError parse_unicode_escape(const char *p, const char *end,
+                                          String &str, const char *&next) {
+    unsigned u;
+    if (!parse_hex4(p, end, u)) return JSON_PARSE_INVALID_UNICODE_HEX;
+    p += 4;
+    if (is_high_surrogate(u)) {
+      if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+        return JSON_PARSE_INVALID_UNICODE_SURROGATE;
+      unsigned low;
+      if (!parse_hex4(p + 2, end, low)) return JSON_PARSE_INVALID_UNICODE_HEX;
+      if (!is_low_surrogate(low)) return JSON_PARSE_INVALID_UNICODE_SURROGATE;
+      u = (((u - 0xD800) << 10) | (low - 0xDC00)) + 0x10000;
+      p += 6;
+    } else if (is_low_surrogate(u)) {
+      return JSON_PARSE_INVALID_UNICODE_SURROGATE;
+    }
+    encode_utf8(str, u);
+    next = p;
+    return JSON_PARSE_OK;
+  }
+  // 字符串里没有转义的一段原始字节，只有打开了validate_utf8才检查
+  bool valid_utf8(const char *p, const char *end) const {
+    return !validate_utf8_ || JsonSimd::validate_utf8(p, end);
+  }
+  // 取出一个字符串：没有转义时直接指向输入，原地解析时在输入里解码，
+  // 否则解码到scratch_里，下一个字符串会覆盖它
+  JParseError parse_string_view(std::string_view &view) {
+    if (context_[curr_index_] != '\"')
+      return JSON_PARSE_STRING_MISS_DOUBLE_QUATION;
+    const char *begin = context_ + curr_index_ + 1;
+    const char *special = JsonSimd::find_string_special(begin, context_ + size_);
+    if (special != context_ + size_ && *special == '\"') {
+      if (!valid_utf8(begin, special)) return JSON_PARSE_INVALID_UTF8;
+      view = std::string_view(begin, special - begin);
+      curr_index_ = special + 1 - context_;
       return JSON_PARSE_OK;
     }
     JParseError err;
-    enum class JParseObjectStatus : char {
-      EXPECTED_KEY = 1,
-      EXPECTED_COLON = 2,
-      EXPECTED_MEMBER = 4,
-      EXPECTED_COMMA = 8,
-      EXPECTED_BRAKCET = 16,
-      ESTABLISHED = 32,
-    } status;
-    status = JParseObjectStatus::EXPECTED_KEY;
-
-    JsonStringType key;
-    std::unique_ptr<JsonImpl> member;
-
-    int object_num = 0;
-
-    std::queue<std::pair<JsonStringType, std::unique_ptr<JsonImpl>>> local_queue;
-    // 获得json_object
-    auto &json_object = std::get<JsonObjectType>(value.obj);
-
-    for (; curr_index_ != size_;) {
-      switch (status) {
-        case JParseObjectStatus::EXPECTED_KEY: {
-          if (context_[curr_index_] == '}') {
-            curr_index_++;
-            return JSON_PARSE_OBJECT_LAST_MUST_NOT_COMMA;
-          }
-          // 解析key
-          JsonImpl tmp;
-          if ((err = parse_string(tmp)) != JSON_PARSE_OK) {
-            return JSON_PARSE_OBJECT_MISS_KEY;
-          }
-          key = std::get<JsonStringType>(tmp.obj);
-          status = JParseObjectStatus::EXPECTED_COLON;
-        } break;
-        case JParseObjectStatus::EXPECTED_COLON:
-          // 解析分号
-          if (context_[curr_index_++] != ':') {
-            return JSON_PARSE_OBJECT_MISS_COLON;
-          }
-          status = JParseObjectStatus::EXPECTED_MEMBER;
-          break;
-        case JParseObjectStatus::EXPECTED_MEMBER:
-          // 解析member
-          if ((err = parse_value(*member)) != JSON_PARSE_OK) {
-            return JSON_PARSE_OBJECT_MISS_MEMBER;
-          }
-          status = JParseObjectStatus::EXPECTED_COMMA;
-          break;
-        case JParseObjectStatus::EXPECTED_COMMA:
-          if (context_[curr_index_] == ',') {
-            object_num++;
-            local_queue.push(std::make_pair<JsonStringType, std::unique_ptr<JsonImpl>>(
-                std::move(key), std::move(member)));
-
-            // reset key and member
-            key.clear();
-            member = std::move(std::make_unique<JsonImpl>());
-            curr_index_++;
-
-            status = JParseObjectStatus::EXPECTED_KEY;
-          } else if (context_[curr_index_] == '}') {
-            object_num++;
-            local_queue.push(std::make_pair<JsonStringType, std::unique_ptr<JsonImpl>>(
-                std::move(key), std::move(member)));
-
-            status = JParseObjectStatus::EXPECTED_BRAKCET;
-          } else {
-            return JSON_PARSE_OBJECT_MISS_COMMA;
-          }
-          break;
-        case JParseObjectStatus::EXPECTED_BRAKCET:
-          if (context_[curr_index_] == '}') {
-            curr_index_++;
-            value.type = EJsonType::JSON_OBJECT;
-
-            while (!local_queue.empty()) {
-              auto &front_elem = local_queue.front();
-              json_object[front_elem.first].reset(front_elem.second.release());
-              local_queue.pop();
-            }
-
-            return JSON_PARSE_OK;
-          } else {
-            return JSON_PARSE_OBJECT_MISS_RIGHT_BRACKET;
-          }
-      }
-      skip_space();
-    }
-
-    assert(curr_index_ == size_);
-    switch (status) {
-      case JParseObjectStatus::EXPECTED_KEY:
-        return JSON_PARSE_OBJECT_MISS_KEY;
-      case JParseObjectStatus::EXPECTED_COLON:
-        return JSON_PARSE_OBJECT_MISS_COLON;
-      case JParseObjectStatus::EXPECTED_MEMBER:
-        return JSON_PARSE_OBJECT_MISS_MEMBER;
-      case JParseObjectStatus::EXPECTED_COMMA:  // 仔细理解这种情况
-        [[fallthrough]];                        // not code error, e.g {"abc": 1
-                          // 这种情况返回的错误应该是缺少'}'
-      case JParseObjectStatus::EXPECTED_BRAKCET:
-        return JSON_PARSE_OBJECT_MISS_RIGHT_BRACKET;
-      default:
-        return JSON_PARSE_INVALID_VALUE;
+    if (insitu_ != nullptr) {
+      InsituString str(insitu_ + curr_index_ + 1);
+      err = parse_string_raw(str);
+      view = std::string_view(str.data(), str.size());
+    } else {
+      scratch_.clear();
+      err = parse_string_raw(scratch_);
+      view = scratch_;
     }
+    return err;
   }
-
-  static JParseError parse_string(JsonImpl &value) {
-    value.obj = std::string("");
-    auto &str = std::get<std::string>(value.obj);
+  // 原地解码的写指针：解码结果不会比原文长，写的位置永远不会超过读的位置
+  class InsituString {
+   public:
+    explicit InsituString(char *data) : data_(data) {}
+    void append(const char *p, size_t n) {
+      // 没有遇到过转义时读写位置重合，不需要移动
+      if (p != data_ + size_) memmove(data_ + size_, p, n);
+      size_ += n;
+    }
+    void push_back(char c) { data_[size_++] = c; }
+    void reserve(size_t) {}
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] const char *data() const { return data_; }
+
+   private:
+    char *data_;
+    size_t size_{0};
+  };
+  // 把字符串内容追加到str后面
+  // 用SIMD找下一个需要处理的字节('"'、'\\'、控制字符)，中间不需要处理的部分整段append
+  template <typename String>
+  JParseError parse_string_raw(String &str) {
     if (context_[curr_index_] != '\"')
       return JSON_PARSE_STRING_MISS_DOUBLE_QUATION;
     curr_index_++;  // 跳过起始的\"
-    bool is_ok;
-    char curr_char;
-    char next_char;
-    bool is_string = false;
-    while (curr_index_ != size_) {
-      curr_char = context_[curr_index_];
-      switch (curr_char) {
+    const char *end = context_ + size_;
+    const char *curr = context_ + curr_index_;
+    bool reserved = false;
+    for (;;) {
+      const char *special = JsonSimd::find_string_special(curr, end);
+      curr_index_ = special - context_;
+      // 转义把字符串分成几段，多字节字符不会跨过转义，每段单独检查
+      if (!valid_utf8(curr, special)) return JSON_PARSE_INVALID_UTF8;
+      str.append(curr, special - curr);
+      if (special == end) return JSON_PARSE_STRING_MISS_DOUBLE_QUATION;
+      switch (*special) {
         case '\"':
-          is_string = true;
-          break;
-        case '\\':
           curr_index_++;
-          if (curr_index_ == size_)
-            return JParseError::JSON_PARSE_INVALID_VALUE;
-          next_char = context_[curr_index_];
-
-          is_ok = parse_zhuanyi_string(str, next_char);
-          if (!is_ok) return JParseError::JSON_PARSE_INVALID_STRING_ESCAPE;
-          break;
-        default:
-          if (curr_char < 0x20) {
-            return JSON_PARSE_INVALID_STRING_CHAR;
+          return JParseError::JSON_PARSE_OK;
+        case '\\':
+          // 有转义时解码结果比原文短，按原文到结束引号的长度一次预留够
+          if (!reserved) {
+            str.reserve(str.size() + escaped_string_length(special, end));
+            reserved = true;
           }
-          str.push_back(curr_char);
+          if (special + 1 == end) return JParseError::JSON_PARSE_INVALID_VALUE;
+          if (special[1] == 'u') {
+            JParseError err = parse_unicode_escape(special + 2, end, str, curr);
+            if (err != JSON_PARSE_OK) return err;
+            break;
+          }
+          if (!parse_zhuanyi_string(str, special[1]))
+            return JParseError::JSON_PARSE_INVALID_STRING_ESCAPE;
+          curr = special + 2;
           break;
+        default:
+          return JSON_PARSE_INVALID_STRING_CHAR;
       }
-      curr_index_++;
-      if (is_string) break;
     }
-  LABEL_STRING_END:
-    value.type = EJsonType::JSON_STRING;
-    return JParseError::JSON_PARSE_OK;
   }
-  static JParseError parse_value_compare_with(const char *str, size_t n) {
-    int index = curr_index_;
-    if (strncmp(&context_[curr_index_], str, n) != 0)
+  // 从p开始到字符串结束引号之间的字节数
+  static size_t escaped_string_length(const char *p, const char *end) {
+    const char *curr = p;
+    for (;;) {
+      curr = JsonSimd::find_string_special(curr, end);
+      if (curr == end || *curr == '\"') break;
+      curr += *curr == '\\' && curr + 1 != end ? 2 : 1;
+    }
+    return curr - p;
+  }
+  // 输入是string_view，不一定以'\0'结尾，先确认剩下的字节放得下字面量
+  JParseError parse_value_compare_with(const char *str, size_t n) {
+    if (size_ - curr_index_ < n || memcmp(context_ + curr_index_, str, n) != 0)
       return JSON_PARSE_INVALID_VALUE;
     curr_index_ += n;
     return JSON_PARSE_OK;
   }
 
  private:
-    // 为了保证线程安全
-  thread_local static const char *context_;
-  thread_local static size_t size_;
-  thread_local static size_t curr_index_;
+  const char *context_{nullptr};
+  size_t size_{0};
+  size_t curr_index_{0};
+  std::pmr::memory_resource *resource_{nullptr};
+  // 原地解析时可写的输入，否则为空
+  char *insitu_{nullptr};
+  // 借用输入，见parse_borrowed
+  bool borrow_{false};
+  // 下面的缓冲区在多次parse之间复用，不会每次重新申请
+  // 有转义、又不能原地解码的字符串解码到这里
+  std::string scratch_;
+  // 事件引擎的容器栈
+  std::vector<Frame> frames_;
+  size_t max_depth_{kDefaultMaxDepth};
+  JsonKeyPool *key_pool_{nullptr};
+  std::vector<std::string_view> key_cache_;
+  bool validate_utf8_{false};
+  // DomBuilder的容器栈和子节点栈
+  std::vector<DomBuilder::Frame> dom_stack_;
+  std::vector<JsonType> dom_values_;
+  std::vector<DomBuilder::Key> dom_keys_;
+  std::string dom_key_bytes_;
+  // JsonTape::Builder的容器栈
+  std::vector<size_t> tape_stack_;
+  // use_arena时返回的树分配在这里
+  bool use_arena_;
+  JsonArena arena_;
 };
+// 静态接口，每个线程用自己的一个JsonParser，见JsonParser
+class JsonParse {
+ public:
+  static std::pair<JsonType, JParseError> parse(std::string_view str) {
+    return local().parse(str);
+  }
+  static std::pair<JsonType, JParseError> parse(const char *context,
+                                                   int size) {
+    return local().parse(std::string_view(context, size));
+  }
+  static JParseError parse(std::string_view str, JsonDocument &doc) {
+    return local().parse(str, doc);
+  }
+  static JParseError parse_parallel(std::string_view str, JsonDocument &doc,
+                                    size_t threads = 0) {
+    return JsonParser::parse_parallel(str, doc, threads);
+  }
+  static std::pair<JsonType, JParseError> parse_insitu(char *buf, size_t n) {
+    return local().parse_insitu(buf, n);
+  }
+  static JParseError parse_insitu(char *buf, size_t n, JsonDocument &doc) {
+    return local().parse_insitu(buf, n, doc);
+  }
+  static std::pair<JsonType, JParseError> parse_borrowed(std::string_view str) {
+    return local().parse_borrowed(str);
+  }
+  static JParseError parse_borrowed(std::string_view str, JsonDocument &doc) {
+    return local().parse_borrowed(str, doc);
+  }
+  static JParseError parse(std::string_view str, JsonTape &tape) {
+    return local().parse(str, tape);
+  }
+  static JParseError parse(std::string_view str, JsonOnDemand &doc) {
+    return local().parse(str, doc);
+  }
+  static size_t parse_many(std::string_view input, JsonBatch &batch,
+                           size_t threads = 0) {
+    return JsonParser::parse_many(input, batch, threads);
+  }
+  template <typename Handler,
+            typename = std::enable_if_t<std::is_class_v<Handler>>>
+  static JParseError parse(std::string_view str, Handler &handler) {
+    return local().parse(str, handler);
+  }
+  // 下面的设置只影响当前线程的parser，parse_many和parse_parallel的工作线程也沿用
+  static void set_max_depth(size_t depth) { local().set_max_depth(depth); }
+  static size_t max_depth() { return local().max_depth(); }
+  static void set_key_pool(JsonKeyPool *pool) { local().set_key_pool(pool); }
+  static JsonKeyPool *key_pool() { return local().key_pool(); }
+  static void set_validate_utf8(bool validate) {
+    local().set_validate_utf8(validate);
+  }
+  static bool validate_utf8() { return local().validate_utf8(); }
 
+  // 生成器，写成紧凑的JSON，用的是当前线程的JsonWriter
+  static std::string stringfy(const JsonType &value);
+  // 写进调用者的buffer，见JsonWriter::write
+  static size_t stringfy(const JsonType &value, char *out, size_t capacity);
+
+ private:
+  // 当前线程的JsonParser
+  static JsonParser &local();
+  static JsonWriter &writer();
+};
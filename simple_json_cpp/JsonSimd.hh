@@ -0,0 +1,354 @@
+#pragma once
+// SIMD相关的公共定义，目前只有x86-64的SSE2/AVX2实现，其它平台走标量代码
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define JSON_SIMD_X86 1
+#include <immintrin.h>
+// 单个函数用AVX2编译，整个工程不需要-mavx2
+#define JSON_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define JSON_SIMD_X86 0
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class JsonSimd {
+ public:
+  // 最低位的1在第几位，bits不能为0
+  static int trailing_zeros(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int n = 0;
+    while ((bits & 1) == 0) {
+      bits >>= 1;
+      n++;
+    }
+    return n;
+#endif
+  }
+
+  // 运行时检测CPU是否支持AVX2，只检测一次
+  static bool has_avx2() {
+#if JSON_SIMD_X86
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  // 找到[p, end)中第一个 '"'、'\\' 或者小于0x20的字节，没有时返回end
+  // 字符串里绝大部分字节都不需要处理，一次判断16/32个字节
+  static const char *find_string_special(const char *p, const char *end) {
+#if JSON_SIMD_X86
+    if (has_avx2()) {
+      p = find_string_special_avx2(p, end);
+    } else {
+      p = find_string_special_sse2(p, end);
+    }
+#endif
+    for (; p != end; p++) {
+      auto c = static_cast<unsigned char>(*p);
+      if (c == '"' || c == '\\' || c < 0x20) break;
+    }
+    return p;
+  }
+
+  // JSON只有四种空白：' ' '\t' '\n' '\r'，不包括isspace认的'\v'和'\f'
+  // 用位掩码代替逐个比较，没有分支
+  static bool is_whitespace(char ch) {
+    constexpr uint64_t kMask =
+        (1ULL << ' ') | (1ULL << '\t') | (1ULL << '\n') | (1ULL << '\r');
+    auto c = static_cast<unsigned char>(ch);
+    return (c <= ' ') & static_cast<bool>((kMask >> (c & 63)) & 1);
+  }
+  // 跳过空白，返回第一个不是空白的位置
+  // 大部分位置没有空白或者只有一个空格，先看两个字节；格式化过的JSON换行后的缩进一次跳16/32个字节
+  static const char *skip_whitespace(const char *p, const char *end) {
+    if (p == end || !is_whitespace(*p)) return p;
+    if (++p == end || !is_whitespace(*p)) return p;
+#if JSON_SIMD_X86
+    if (has_avx2()) {
+      p = skip_whitespace_avx2(p, end);
+    } else {
+      p = skip_whitespace_sse2(p, end);
+    }
+#endif
+    while (p != end && is_whitespace(*p)) p++;
+    return p;
+  }
+
+  // [p, end)是否是合法的UTF-8：不能有过长编码、代理区(U+D800..U+DFFF)和大于U+10FFFF的码点
+  // 先一次16/32个字节跳过ASCII；有AVX2时多字节字符也按块查表检查(simdjson的lookup算法)，
+  // 否则逐个字符检查
+  static bool validate_utf8(const char *p, const char *end) {
+    p = skip_ascii(p, end);
+    if (p == end) return true;
+#if JSON_SIMD_X86
+    if (has_avx2()) return validate_utf8_avx2(p, end);
+#endif
+    for (;;) {
+      p = skip_ascii(p, end);
+      if (p == end) return true;
+      // 中文这类文本多字节字符连成一片，连续的多字节字符和夹在中间的少量ASCII都在这里处理
+      do {
+        if (static_cast<unsigned char>(*p) < 0x80) {
+          p++;
+        } else if ((p = skip_utf8_sequence(p, end)) == nullptr) {
+          return false;
+        }
+      } while (p != end && (static_cast<unsigned char>(*p) >= 0x80 ||
+                            (end - p > 1 && static_cast<unsigned char>(p[1]) >= 0x80)));
+    }
+  }
+
+ private:
+  // 找到第一个不是ASCII的字节
+  static const char *skip_ascii(const char *p, const char *end) {
+#if JSON_SIMD_X86
+    if (has_avx2()) {
+      p = skip_ascii_avx2(p, end);
+    } else {
+      p = skip_ascii_sse2(p, end);
+    }
+#endif
+    while (p != end && static_cast<unsigned char>(*p) < 0x80) p++;
+    return p;
+  }
+  // p指向一个多字节字符的首字节，返回下一个字符，不合法时返回nullptr
+  // 第二个字节的范围取决于首字节，见Unicode标准的表3-7
+  static const char *skip_utf8_sequence(const char *p, const char *end) {
+    auto lead = static_cast<unsigned char>(*p);
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      length = 3;
+      if (lead == 0xE0) low = 0xA0;
+      if (lead == 0xED) high = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      length = 4;
+      if (lead == 0xF0) low = 0x90;
+      if (lead == 0xF4) high = 0x8F;
+    } else {
+      return nullptr;
+    }
+    if (static_cast<size_t>(end - p) < length) return nullptr;
+    auto second = static_cast<unsigned char>(p[1]);
+    if (second < low || second > high) return nullptr;
+    for (size_t i = 2; i < length; i++) {
+      if ((static_cast<unsigned char>(p[i]) & 0xC0) != 0x80) return nullptr;
+    }
+    return p + length;
+  }
+
+#if JSON_SIMD_X86
+  // Keiser和Lemire的lookup算法，每个字节和它前面的1~3个字节一起判断，没有分支：
+  //   1. 前一个字节的高4位、低4位和这个字节的高4位各查一次16项的表，三个结果相与，
+  //      非0就是两个字节的组合不合法(太短、太长、过长编码、代理区、超过U+10FFFF)
+  //   2. 往前第2/3个字节是3/4字节字符的首字节时，这个字节必须是后续字节，
+  //      第1步把"两个后续字节相连"标成了TWO_CONTS，这里异或之后正好抵消
+  // 块的结尾停在多字节字符中间时记下来，后面全是ASCII或者输入结束就是错的
+  static constexpr uint8_t kTooShort = 1 << 0;   // 11______ 0_______ 或 11______ 11______
+  static constexpr uint8_t kTooLong = 1 << 1;    // 0_______ 10______
+  static constexpr uint8_t kOverlong3 = 1 << 2;  // 11100000 100_____
+  static constexpr uint8_t kTooLarge = 1 << 3;   // 11110100 1001____ 以及更大
+  static constexpr uint8_t kSurrogate = 1 << 4;  // 11101101 101_____
+  static constexpr uint8_t kOverlong2 = 1 << 5;  // 1100000_ 10______
+  static constexpr uint8_t kTooLarge1000 = 1 << 6;  // 11110101 1000____ 以及更大
+  static constexpr uint8_t kOverlong4 = 1 << 6;  // 11110000 1000____
+  static constexpr uint8_t kTwoConts = 1 << 7;   // 10______ 10______
+  static constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+  // 两个128位的lane各查同一张表
+  JSON_TARGET_AVX2 static __m256i lookup16(__m256i index, __m128i table) {
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table), index);
+  }
+  JSON_TARGET_AVX2 static __m256i high_nibble(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+  }
+  // input往前错N个字节，前面补上prev的最后N个字节
+  template <int N>
+  JSON_TARGET_AVX2 static __m256i prev_bytes(__m256i input, __m256i prev) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21),
+                              16 - N);
+  }
+  JSON_TARGET_AVX2 static __m256i utf8_block_errors(__m256i input, __m256i prev) {
+    __m256i prev1 = prev_bytes<1>(input, prev);
+    const __m128i byte1_high_table = _mm_setr_epi8(
+        // 0_______ 前一个是ASCII
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        // 10______ 前一个是后续字节
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        // 1100____ 1101____ 两字节的首字节
+        kTooShort | kOverlong2, kTooShort,
+        // 1110____ 三字节的首字节
+        kTooShort | kOverlong3 | kSurrogate,
+        // 1111____ 四字节的首字节
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+    const __m128i byte1_low_table = _mm_setr_epi8(
+        // ____0000 ____0001
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2,
+        // ____001_
+        kCarry, kCarry,
+        // ____0100 ____0101 ____011_
+        kCarry | kTooLarge, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        // ____1___，其中____1101是代理区的首字节
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000);
+    const __m128i byte2_high_table = _mm_setr_epi8(
+        // 0_______ 这个是ASCII
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooShort,
+        // 1000____
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+        // 1001____
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+        // 101_____
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        // 11______ 这个是首字节
+        kTooShort, kTooShort, kTooShort, kTooShort);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(lookup16(high_nibble(prev1), byte1_high_table),
+                         lookup16(_mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)),
+                                  byte1_low_table)),
+        lookup16(high_nibble(input), byte2_high_table));
+    // 只有111_____减去0x60、1111____减去0x70之后最高位还是1
+    __m256i third = _mm256_subs_epu8(prev_bytes<2>(input, prev), _mm256_set1_epi8(0x60));
+    __m256i fourth = _mm256_subs_epu8(prev_bytes<3>(input, prev), _mm256_set1_epi8(0x70));
+    __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                             _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must_continue, special);
+  }
+  // 最后三个字节是否是还没有结束的多字节字符的开头
+  JSON_TARGET_AVX2 static __m256i utf8_incomplete(__m256i input) {
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1),
+        static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, max);
+  }
+  JSON_TARGET_AVX2 static bool validate_utf8_avx2(const char *p, const char *end) {
+    __m256i prev = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    auto check = [&](__m256i input) JSON_TARGET_AVX2 {
+      if (_mm256_movemask_epi8(input) == 0) {
+        error = _mm256_or_si256(error, incomplete);
+        incomplete = _mm256_setzero_si256();
+      } else {
+        error = _mm256_or_si256(error, utf8_block_errors(input, prev));
+        incomplete = utf8_incomplete(input);
+      }
+      prev = input;
+    };
+    for (; end - p >= 32; p += 32)
+      check(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+    if (p != end) {
+      // 剩下的不到32个字节，后面补0(ASCII)
+      alignas(32) char tail[32] = {};
+      memcpy(tail, p, end - p);
+      check(_mm256_load_si256(reinterpret_cast<const __m256i *>(tail)));
+    }
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error) != 0;
+  }
+
+  // 最高位就是符号位，movemask直接得到非ASCII字节的位置
+  static const char *skip_ascii_sse2(const char *p, const char *end) {
+    for (; end - p >= 16; p += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      int mask = _mm_movemask_epi8(v);
+      if (mask != 0) return p + trailing_zeros(mask);
+    }
+    return p;
+  }
+  JSON_TARGET_AVX2 static const char *skip_ascii_avx2(const char *p,
+                                                      const char *end) {
+    for (; end - p >= 32; p += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+      if (mask != 0) return p + trailing_zeros(mask);
+    }
+    return skip_ascii_sse2(p, end);
+  }
+#endif
+#if JSON_SIMD_X86
+  // 四种空白各比较一次，取反后第一个1就是第一个非空白字节
+  static const char *skip_whitespace_sse2(const char *p, const char *end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i ws = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+          _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+      int mask = ~_mm_movemask_epi8(ws) & 0xFFFF;
+      if (mask != 0) return p + trailing_zeros(mask);
+    }
+    return p;
+  }
+  JSON_TARGET_AVX2 static const char *skip_whitespace_avx2(const char *p,
+                                                           const char *end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    for (; end - p >= 32; p += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i ws = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+      auto mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+      if (mask != 0) return p + trailing_zeros(mask);
+    }
+    return skip_whitespace_sse2(p, end);
+  }
+#endif
+#if JSON_SIMD_X86
+  // 只处理完整的16字节块，剩下的交给标量代码
+  static const char *find_string_special_sse2(const char *p, const char *end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      // 无符号的 v <= 0x1F 等价于 min(v, 0x1F) == v
+      __m128i hit = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+          _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+      int mask = _mm_movemask_epi8(hit);
+      if (mask != 0) return p + trailing_zeros(mask);
+    }
+    return p;
+  }
+  JSON_TARGET_AVX2 static const char *find_string_special_avx2(const char *p,
+                                                               const char *end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    for (; end - p >= 32; p += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i hit = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                          _mm256_cmpeq_epi8(v, backslash)),
+          _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+      if (mask != 0) return p + trailing_zeros(mask);
+    }
+    return find_string_special_sse2(p, end);
+  }
+#endif
+};
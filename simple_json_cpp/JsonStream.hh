@@ -0,0 +1,474 @@
+#pragma once
+#include "JsonHandler.hh"
+#include "JsonParse.hh"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 分块输入的流式解析：输入可以在任意字节处断开，比如字符串、数字、转义的中间
+//   JsonStreamParser<Handler> parser(handler);
+//   while (读到一块) parser.feed(buf, n);
+//   parser.finish();
+// 事件和错误码与JsonParse::parse(str, handler)一致，见JsonHandler.hh
+// 只保存容器栈和当前未结束的一个字符串或数字，内存与输入总长度无关
+// feed之后就可以复用这块buffer；string和key的参数只在回调期间有效
+template <typename Handler>
+class JsonStreamParser {
+ public:
+  explicit JsonStreamParser(Handler &handler) : handler_(handler) {}
+
+  // 出错之后的输入全部忽略，返回第一个错误
+  JParseError feed(const char *data, size_t size);
+  // 输入结束，检查文档是否完整
+  JParseError finish();
+  // 同JsonParser::set_max_depth和JsonParser::set_validate_utf8
+  void set_max_depth(size_t depth) { max_depth_ = depth; }
+  void set_validate_utf8(bool validate) { validate_utf8_ = validate; }
+  // 丢掉当前状态，解析下一个文档
+  void reset() {
+    stack_.clear();
+    buffer_.clear();
+    escape_.clear();
+    segment_ = 0;
+    state_ = State::ROOT;
+    err_ = JSON_PARSE_OK;
+  }
+
+ private:
+  enum class State : uint8_t {
+    ROOT,          // 等待根节点
+    ARRAY_FIRST,   // '['之后：值或']'
+    ARRAY_VALUE,   // ','之后：值
+    ARRAY_NEXT,    // 元素之后：','或']'
+    OBJECT_FIRST,  // '{'之后：key或'}'
+    OBJECT_KEY,    // ','之后：key
+    OBJECT_COLON,  // key之后：':'
+    OBJECT_VALUE,  // ':'之后：值
+    OBJECT_NEXT,   // 成员之后：','或'}'
+    DONE,          // 根节点结束，后面只能有空白
+    // 下面的状态在一个值的中间，可能跨过块的边界
+    STRING,
+    STRING_ESCAPE,
+    STRING_UNICODE,  // \u之后的十六进制数，代理对要等到第二个\uXXXX
+    NUMBER,
+    LITERAL,
+  };
+  struct Frame {
+    char type;  // '['或'{'
+    size_t count;
+  };
+
+  bool valid_utf8(const char *p, const char *end) const {
+    return !validate_utf8_ || JsonSimd::validate_utf8(p, end);
+  }
+  static bool is_number_char(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+  }
+
+  // 下面的函数处理从p开始的输入，返回处理到的位置，出错时返回nullptr
+  const char *parse_structural(const char *p);
+  const char *begin_value(const char *p);
+  const char *begin_literal(const char *p, const char *literal, size_t size);
+  const char *parse_string(const char *p, const char *end);
+  const char *parse_unicode(const char *p, const char *end);
+  const char *parse_literal(const char *p, const char *end);
+  const char *parse_number(const char *p, const char *end);
+  const char *end_number(const char *first, const char *last, const char *next);
+  const char *end_string(std::string_view str, const char *next);
+  const char *end_value(const char *next);
+  const char *close(const char *p);
+
+  // 错误码按JsonParse的规则逐层转换：嵌套的值出错时，外层容器报自己的错误
+  const char *fail(JParseError err) {
+    if (stack_.size() > 1)
+      err = stack_[0].type == '[' ? JSON_PARSE_ARRAY_MISS_VALUE
+                                  : JSON_PARSE_OBJECT_MISS_MEMBER;
+    err_ = err;
+    return nullptr;
+  }
+  // 当前的字符串、数字或字面量不合法
+  const char *fail_value(JParseError err) {
+    if (!stack_.empty()) {
+      if (stack_.back().type == '[')
+        err = JSON_PARSE_ARRAY_MISS_VALUE;
+      else if (key_ && (state_ == State::STRING || state_ == State::STRING_ESCAPE ||
+                        state_ == State::STRING_UNICODE))
+        err = JSON_PARSE_OBJECT_MISS_KEY;
+      else
+        err = JSON_PARSE_OBJECT_MISS_MEMBER;
+    }
+    return fail(err);
+  }
+  const char *terminate() {
+    err_ = JSON_PARSE_TERMINATED;
+    return nullptr;
+  }
+  const char *too_deep() {
+    err_ = JSON_PARSE_DEPTH_EXCEEDED;
+    return nullptr;
+  }
+
+  Handler &handler_;
+  std::vector<Frame> stack_;
+  size_t max_depth_{JsonParser::kDefaultMaxDepth};
+  bool validate_utf8_{false};
+  // 跨块的字符串(已经解码的部分)或数字
+  std::string buffer_;
+  // buffer_里最后一个转义之后的位置，从这里开始的原始字节还没有检查UTF-8
+  size_t segment_{0};
+  // \u之后还没有解码的字节，攒够escape_size_个再解码：
+  // 4个十六进制数，是高代理时再加上后面的\uXXXX共10个
+  std::string escape_;
+  size_t escape_size_{4};
+  State state_{State::ROOT};
+  JParseError err_{JSON_PARSE_OK};
+  bool key_{false};
+  const char *literal_{nullptr};
+  size_t literal_size_{0};
+  size_t matched_{0};
+};
+
+template <typename Handler>
+JParseError JsonStreamParser<Handler>::feed(const char *data, size_t size) {
+  const char *p = data;
+  const char *end = data + size;
+  while (err_ == JSON_PARSE_OK && p != end) {
+    switch (state_) {
+      case State::STRING:
+        p = parse_string(p, end);
+        break;
+      case State::STRING_ESCAPE:
+        if (*p == 'u') {
+          escape_.clear();
+          escape_size_ = 4;
+          state_ = State::STRING_UNICODE;
+          p++;
+          break;
+        }
+        if (!JsonParser::parse_zhuanyi_string(buffer_, *p)) {
+          p = fail_value(JSON_PARSE_INVALID_STRING_ESCAPE);
+          break;
+        }
+        state_ = State::STRING;
+        segment_ = buffer_.size();
+        p++;
+        break;
+      case State::STRING_UNICODE:
+        p = parse_unicode(p, end);
+        break;
+      case State::NUMBER:
+        p = parse_number(p, end);
+        break;
+      case State::LITERAL:
+        p = parse_literal(p, end);
+        break;
+      default:
+        if (JsonSimd::is_whitespace(*p))
+          p = JsonSimd::skip_whitespace(p, end);
+        else
+          p = parse_structural(p);
+        break;
+    }
+  }
+  return err_;
+}
+
+template <typename Handler>
+JParseError JsonStreamParser<Handler>::finish() {
+  if (err_ != JSON_PARSE_OK) return err_;
+  // 数字只有看到后面的字节才知道结束了
+  if (state_ == State::NUMBER) {
+    end_number(buffer_.data(), buffer_.data() + buffer_.size(), nullptr);
+    if (err_ != JSON_PARSE_OK) return err_;
+  }
+  switch (state_) {
+    case State::DONE:
+      break;
+    case State::ROOT:
+      fail(JSON_PARSE_EXPECT_VALUE);
+      break;
+    case State::ARRAY_FIRST:
+    case State::ARRAY_VALUE:
+      fail(JSON_PARSE_ARRAY_MISS_VALUE);
+      break;
+    case State::ARRAY_NEXT:
+      fail(JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET);
+      break;
+    case State::OBJECT_FIRST:
+    case State::OBJECT_KEY:
+      fail(JSON_PARSE_OBJECT_MISS_KEY);
+      break;
+    case State::OBJECT_COLON:
+      fail(JSON_PARSE_OBJECT_MISS_COLON);
+      break;
+    case State::OBJECT_VALUE:
+      fail(JSON_PARSE_OBJECT_MISS_MEMBER);
+      break;
+    case State::OBJECT_NEXT:
+      fail(JSON_PARSE_OBJECT_MISS_RIGHT_BRACKET);
+      break;
+    case State::STRING:
+      if (!valid_utf8(buffer_.data() + segment_, buffer_.data() + buffer_.size()))
+        fail_value(JSON_PARSE_INVALID_UTF8);
+      else
+        fail_value(JSON_PARSE_STRING_MISS_DOUBLE_QUATION);
+      break;
+    case State::STRING_UNICODE: {
+      // 转义不完整，错误码和整块解析时在输入末尾遇到的一样
+      const char *next;
+      fail_value(JsonParser::parse_unicode_escape(
+          escape_.data(), escape_.data() + escape_.size(), buffer_, next));
+      break;
+    }
+    case State::STRING_ESCAPE:
+    case State::LITERAL:
+    default:
+      fail_value(JSON_PARSE_INVALID_VALUE);
+      break;
+  }
+  return err_;
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::parse_structural(const char *p) {
+  switch (state_) {
+    case State::ROOT:
+    case State::OBJECT_VALUE:
+      return begin_value(p);
+    case State::ARRAY_FIRST:
+      if (*p == ']') return close(p);
+      return begin_value(p);
+    case State::ARRAY_VALUE:
+      if (*p == ']') return fail(JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA);
+      return begin_value(p);
+    case State::ARRAY_NEXT:
+      if (*p == ']') return close(p);
+      if (*p != ',') return fail(JSON_PARSE_ARRAY_MISS_COMMA);
+      state_ = State::ARRAY_VALUE;
+      return p + 1;
+    case State::OBJECT_FIRST:
+      if (*p == '}') return close(p);
+      [[fallthrough]];
+    case State::OBJECT_KEY:
+      if (*p == '}') return fail(JSON_PARSE_OBJECT_LAST_MUST_NOT_COMMA);
+      if (*p != '\"') return fail(JSON_PARSE_OBJECT_MISS_KEY);
+      key_ = true;
+      buffer_.clear();
+      segment_ = 0;
+      state_ = State::STRING;
+      return p + 1;
+    case State::OBJECT_COLON:
+      if (*p != ':') return fail(JSON_PARSE_OBJECT_MISS_COLON);
+      state_ = State::OBJECT_VALUE;
+      return p + 1;
+    case State::OBJECT_NEXT:
+      if (*p == '}') return close(p);
+      if (*p != ',') return fail(JSON_PARSE_OBJECT_MISS_COMMA);
+      state_ = State::OBJECT_KEY;
+      return p + 1;
+    default:
+      return fail(JSON_PARSE_ROOT_NOT_SINGULAR);
+  }
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::begin_value(const char *p) {
+  switch (*p) {
+    case '\"':
+      key_ = false;
+      buffer_.clear();
+      segment_ = 0;
+      state_ = State::STRING;
+      return p + 1;
+    case 'n':
+      return begin_literal(p, "null", 4);
+    case 't':
+      return begin_literal(p, "true", 4);
+    case 'f':
+      return begin_literal(p, "false", 5);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      buffer_.clear();
+      state_ = State::NUMBER;
+      return p;
+    case '[':
+      if (stack_.size() >= max_depth_) return too_deep();
+      if (!handler_.start_array()) return terminate();
+      stack_.push_back(Frame{'[', 0});
+      state_ = State::ARRAY_FIRST;
+      return p + 1;
+    case '{':
+      if (stack_.size() >= max_depth_) return too_deep();
+      if (!handler_.start_object()) return terminate();
+      stack_.push_back(Frame{'{', 0});
+      state_ = State::OBJECT_FIRST;
+      return p + 1;
+    case '\0':
+      return fail_value(JSON_PARSE_EXPECT_VALUE);
+    default:
+      return fail_value(JSON_PARSE_INVALID_VALUE);
+  }
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::begin_literal(const char *p,
+                                                     const char *literal,
+                                                     size_t size) {
+  literal_ = literal;
+  literal_size_ = size;
+  matched_ = 0;
+  state_ = State::LITERAL;
+  return p;
+}
+
+// 整个字符串都在这一块里并且没有转义时，直接把块里的内容交给handler
+template <typename Handler>
+const char *JsonStreamParser<Handler>::parse_string(const char *p,
+                                                    const char *end) {
+  const char *special = JsonSimd::find_string_special(p, end);
+  if (special == end) {
+    buffer_.append(p, end - p);
+    return end;
+  }
+  // 整个字符串都在这一块里时不用拷贝
+  bool direct = buffer_.empty();
+  if (!direct) buffer_.append(p, special - p);
+  // 和JsonParser一样按转义分段检查，跨块的段已经拼在buffer_里
+  bool valid = direct ? valid_utf8(p, special)
+                      : valid_utf8(buffer_.data() + segment_,
+                                   buffer_.data() + buffer_.size());
+  if (!valid) return fail_value(JSON_PARSE_INVALID_UTF8);
+  switch (*special) {
+    case '\"':
+      if (direct)
+        return end_string(std::string_view(p, special - p), special + 1);
+      return end_string(buffer_, special + 1);
+    case '\\':
+      if (direct) buffer_.append(p, special - p);
+      state_ = State::STRING_ESCAPE;
+      return special + 1;
+    default:
+      return fail_value(JSON_PARSE_INVALID_STRING_CHAR);
+  }
+}
+
+// 攒够4个十六进制数再解码，高代理还要再攒\uXXXX
+// 整块解析时只看这几个字节，所以错误码也一样
+template <typename Handler>
+const char *JsonStreamParser<Handler>::parse_unicode(const char *p,
+                                                     const char *end) {
+  while (p != end && escape_.size() < escape_size_) {
+    escape_.push_back(*p++);
+    // 第4个十六进制数到了才知道是不是代理对，只判断这一次
+    unsigned u;
+    if (escape_.size() == 4 &&
+        JsonParser::parse_hex4(escape_.data(), escape_.data() + 4, u) &&
+        JsonParser::is_high_surrogate(u))
+      escape_size_ = 10;
+  }
+  if (escape_.size() < escape_size_) return p;
+  const char *next;
+  JParseError err = JsonParser::parse_unicode_escape(
+      escape_.data(), escape_.data() + escape_.size(), buffer_, next);
+  if (err != JSON_PARSE_OK) return fail_value(err);
+  state_ = State::STRING;
+  segment_ = buffer_.size();
+  return p;
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::end_string(std::string_view str,
+                                                  const char *next) {
+  if (!key_) {
+    if (!handler_.string(str)) return terminate();
+    return end_value(next);
+  }
+  if (!handler_.key(str)) return terminate();
+  state_ = State::OBJECT_COLON;
+  return next;
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::parse_literal(const char *p,
+                                                     const char *end) {
+  for (; p != end && matched_ != literal_size_; p++, matched_++) {
+    if (*p != literal_[matched_]) return fail_value(JSON_PARSE_INVALID_VALUE);
+  }
+  if (matched_ != literal_size_) return p;
+  bool ok = literal_[0] == 'n' ? handler_.null()
+                               : handler_.boolean(literal_[0] == 't');
+  if (!ok) return terminate();
+  return end_value(p);
+}
+
+// 数字的字节全部在这一块里时直接计算，否则先攒在buffer_里
+template <typename Handler>
+const char *JsonStreamParser<Handler>::parse_number(const char *p,
+                                                    const char *end) {
+  const char *last = p;
+  while (last != end && is_number_char(*last)) last++;
+  if (last == end) {
+    buffer_.append(p, end - p);
+    return end;
+  }
+  if (buffer_.empty()) return end_number(p, last, last);
+  buffer_.append(p, last - p);
+  return end_number(buffer_.data(), buffer_.data() + buffer_.size(), last);
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::end_number(const char *first,
+                                                  const char *last,
+                                                  const char *next) {
+  if (JsonNumber::scan(first, last) != last)
+    return fail_value(JSON_PARSE_INVALID_VALUE);
+  JsonNumber::Value num = JsonNumber::parse(first, last);
+  bool ok;
+  switch (num.kind) {
+    case JsonNumber::Kind::INT64:
+      ok = handler_.int64(num.i);
+      break;
+    case JsonNumber::Kind::UINT64:
+      ok = handler_.uint64(num.u);
+      break;
+    default:
+      ok = handler_.number(num.d);
+      break;
+  }
+  if (!ok) return terminate();
+  return end_value(next);
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::end_value(const char *next) {
+  if (stack_.empty()) {
+    state_ = State::DONE;
+    return next;
+  }
+  Frame &top = stack_.back();
+  top.count++;
+  state_ = top.type == '[' ? State::ARRAY_NEXT : State::OBJECT_NEXT;
+  return next;
+}
+
+template <typename Handler>
+const char *JsonStreamParser<Handler>::close(const char *p) {
+  Frame frame = stack_.back();
+  stack_.pop_back();
+  bool ok = frame.type == '[' ? handler_.end_array(frame.count)
+                              : handler_.end_object(frame.count);
+  if (!ok) return terminate();
+  return end_value(p + 1);
+}
@@ -0,0 +1,262 @@
+#include "JsonStructural.hh"
+
+#include <array>
+#include <cstring>
+
+#include "JsonSimd.hh"
+
+namespace {
+constexpr size_t kBlockSize = 64;
+
+// 一个块里各类字符的位掩码，第i位对应块里第i个字节
+struct BlockMasks {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t op;     // { } [ ] : ,
+  uint64_t space;  // JSON只有这四种空白: ' ' '\t' '\n' '\r'
+};
+
+// 前缀异或：第i位变成原来第0..i位的异或，把引号的位置变成字符串所在的区间
+inline uint64_t prefix_xor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+// 逐块计算结构位置，块与块之间的状态(转义、字符串、值)保存在这里
+class BlockScanner {
+ public:
+  uint64_t next(const BlockMasks &masks) {
+    uint64_t quote = masks.quote & ~find_escaped(masks.backslash);
+    // 字符串区间，包含起始引号，不包含结束引号
+    uint64_t in_string = prefix_xor(quote) ^ prev_in_string_;
+    prev_in_string_ = uint64_t(int64_t(in_string) >> 63);
+    // 字符串内部以及结束引号，这些位置都不是结构位置
+    uint64_t string_tail = in_string ^ quote;
+
+    // 值的第一个字节：不是结构字符也不是空白，并且前一个字节不属于同一个值
+    uint64_t scalar = ~(masks.op | masks.space);
+    uint64_t nonquote_scalar = scalar & ~quote;
+    uint64_t follows_scalar = (nonquote_scalar << 1) | prev_scalar_;
+    prev_scalar_ = nonquote_scalar >> 63;
+    uint64_t scalar_start = scalar & ~follows_scalar;
+
+    return (masks.op | scalar_start) & ~string_tail;
+  }
+
+  [[nodiscard]] bool in_string() const { return prev_in_string_ != 0; }
+
+ private:
+  // 被转义的字符：连续奇数个反斜杠后面的那个字符
+  // 从奇数位开始的反斜杠串加上自身会把进位推到串的末尾，借此区分串的长度奇偶
+  uint64_t find_escaped(uint64_t backslash) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    // 上一块末尾的反斜杠已经转义了这一块的第一个字节
+    backslash &= ~prev_escaped_;
+    uint64_t follows_escape = (backslash << 1) | prev_escaped_;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_starts = odd_starts + backslash;
+    prev_escaped_ = even_starts < odd_starts ? 1 : 0;
+    uint64_t invert_mask = even_starts << 1;
+    return (even_bits ^ invert_mask) & follows_escape;
+  }
+
+  uint64_t prev_escaped_{0};
+  uint64_t prev_in_string_{0};
+  uint64_t prev_scalar_{0};
+};
+
+inline void flatten(uint64_t bits, uint32_t base, std::vector<uint32_t> &out) {
+  while (bits != 0) {
+    out.push_back(base + JsonSimd::trailing_zeros(bits));
+    bits &= bits - 1;
+  }
+}
+
+// 最后不满一块的部分用空格补齐
+inline void load_tail(char *block, const char *src, size_t len) {
+  memset(block, ' ', kBlockSize);
+  memcpy(block, src, len);
+}
+
+enum : uint8_t {
+  kQuote = 1,
+  kBackslash = 2,
+  kOp = 4,
+  kSpace = 8,
+};
+
+constexpr std::array<uint8_t, 256> make_char_class() {
+  std::array<uint8_t, 256> table{};
+  table['"'] = kQuote;
+  table['\\'] = kBackslash;
+  table['{'] = table['}'] = table['['] = table[']'] = kOp;
+  table[':'] = table[','] = kOp;
+  table[' '] = table['\t'] = table['\n'] = table['\r'] = kSpace;
+  return table;
+}
+constexpr std::array<uint8_t, 256> kCharClass = make_char_class();
+
+BlockMasks classify_scalar(const char *block) {
+  BlockMasks masks{0, 0, 0, 0};
+  for (size_t i = 0; i < kBlockSize; i++) {
+    uint8_t cls = kCharClass[static_cast<uint8_t>(block[i])];
+    masks.quote |= uint64_t((cls & kQuote) != 0) << i;
+    masks.backslash |= uint64_t((cls & kBackslash) != 0) << i;
+    masks.op |= uint64_t((cls & kOp) != 0) << i;
+    masks.space |= uint64_t((cls & kSpace) != 0) << i;
+  }
+  return masks;
+}
+
+void scan_scalar(const char *buf, size_t len, BlockScanner &scanner,
+                 std::vector<uint32_t> &out) {
+  size_t i = 0;
+  for (; i + kBlockSize <= len; i += kBlockSize)
+    flatten(scanner.next(classify_scalar(buf + i)), i, out);
+  if (i < len) {
+    char block[kBlockSize];
+    load_tail(block, buf + i, len - i);
+    flatten(scanner.next(classify_scalar(block)), i, out);
+  }
+}
+
+#if JSON_SIMD_X86
+inline __m128i eq_sse2(__m128i v, char c) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+// 4个16字节的掩码拼成64位
+inline uint64_t movemask_sse2(__m128i m0, __m128i m1, __m128i m2, __m128i m3) {
+  return uint64_t(uint16_t(_mm_movemask_epi8(m0))) |
+         uint64_t(uint16_t(_mm_movemask_epi8(m1))) << 16 |
+         uint64_t(uint16_t(_mm_movemask_epi8(m2))) << 32 |
+         uint64_t(uint16_t(_mm_movemask_epi8(m3))) << 48;
+}
+
+inline BlockMasks classify_sse2(const char *block) {
+  __m128i v[4];
+  for (int i = 0; i < 4; i++)
+    v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+  __m128i quote[4], backslash[4], op[4], space[4];
+  for (int i = 0; i < 4; i++) {
+    quote[i] = eq_sse2(v[i], '"');
+    backslash[i] = eq_sse2(v[i], '\\');
+    op[i] = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(eq_sse2(v[i], '{'), eq_sse2(v[i], '}')),
+                     _mm_or_si128(eq_sse2(v[i], '['), eq_sse2(v[i], ']'))),
+        _mm_or_si128(eq_sse2(v[i], ':'), eq_sse2(v[i], ',')));
+    space[i] =
+        _mm_or_si128(_mm_or_si128(eq_sse2(v[i], ' '), eq_sse2(v[i], '\t')),
+                     _mm_or_si128(eq_sse2(v[i], '\n'), eq_sse2(v[i], '\r')));
+  }
+  return BlockMasks{
+      movemask_sse2(quote[0], quote[1], quote[2], quote[3]),
+      movemask_sse2(backslash[0], backslash[1], backslash[2], backslash[3]),
+      movemask_sse2(op[0], op[1], op[2], op[3]),
+      movemask_sse2(space[0], space[1], space[2], space[3]),
+  };
+}
+
+void scan_sse2(const char *buf, size_t len, BlockScanner &scanner,
+               std::vector<uint32_t> &out) {
+  size_t i = 0;
+  for (; i + kBlockSize <= len; i += kBlockSize)
+    flatten(scanner.next(classify_sse2(buf + i)), i, out);
+  if (i < len) {
+    char block[kBlockSize];
+    load_tail(block, buf + i, len - i);
+    flatten(scanner.next(classify_sse2(block)), i, out);
+  }
+}
+
+JSON_TARGET_AVX2 inline __m256i eq_avx2(__m256i v, char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+JSON_TARGET_AVX2 inline uint64_t movemask_avx2(__m256i lo, __m256i hi) {
+  return uint64_t(uint32_t(_mm256_movemask_epi8(lo))) |
+         uint64_t(uint32_t(_mm256_movemask_epi8(hi))) << 32;
+}
+
+JSON_TARGET_AVX2 inline BlockMasks classify_avx2(const char *block) {
+  __m256i v[2];
+  v[0] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+  v[1] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+  __m256i quote[2], backslash[2], op[2], space[2];
+  for (int i = 0; i < 2; i++) {
+    quote[i] = eq_avx2(v[i], '"');
+    backslash[i] = eq_avx2(v[i], '\\');
+    op[i] = _mm256_or_si256(
+        _mm256_or_si256(_mm256_or_si256(eq_avx2(v[i], '{'), eq_avx2(v[i], '}')),
+                        _mm256_or_si256(eq_avx2(v[i], '['), eq_avx2(v[i], ']'))),
+        _mm256_or_si256(eq_avx2(v[i], ':'), eq_avx2(v[i], ',')));
+    space[i] = _mm256_or_si256(
+        _mm256_or_si256(eq_avx2(v[i], ' '), eq_avx2(v[i], '\t')),
+        _mm256_or_si256(eq_avx2(v[i], '\n'), eq_avx2(v[i], '\r')));
+  }
+  return BlockMasks{
+      movemask_avx2(quote[0], quote[1]),
+      movemask_avx2(backslash[0], backslash[1]),
+      movemask_avx2(op[0], op[1]),
+      movemask_avx2(space[0], space[1]),
+  };
+}
+
+JSON_TARGET_AVX2 void scan_avx2(const char *buf, size_t len,
+                                BlockScanner &scanner,
+                                std::vector<uint32_t> &out) {
+  size_t i = 0;
+  for (; i + kBlockSize <= len; i += kBlockSize)
+    flatten(scanner.next(classify_avx2(buf + i)), i, out);
+  if (i < len) {
+    char block[kBlockSize];
+    load_tail(block, buf + i, len - i);
+    flatten(scanner.next(classify_avx2(block)), i, out);
+  }
+}
+#endif
+
+// 不支持的指令集退回到能用的最快实现
+JsonStructuralIndex::Kernel pick_kernel(JsonStructuralIndex::Kernel kernel) {
+  using Kernel = JsonStructuralIndex::Kernel;
+#if JSON_SIMD_X86
+  if (kernel == Kernel::AUTO || kernel == Kernel::AVX2)
+    return JsonSimd::has_avx2() ? Kernel::AVX2 : Kernel::SSE2;
+  return kernel;
+#else
+  (void)kernel;
+  return Kernel::SCALAR;
+#endif
+}
+}  // namespace
+
+bool JsonStructuralIndex::build(std::string_view json, Kernel kernel) {
+  clear();
+  if (json.size() > UINT32_MAX) return false;
+  // 一般的JSON里结构位置大约占1/4到1/8
+  positions_.reserve(json.size() / 4 + kBlockSize);
+
+  BlockScanner scanner;
+  switch (pick_kernel(kernel)) {
+#if JSON_SIMD_X86
+    case Kernel::AVX2:
+      scan_avx2(json.data(), json.size(), scanner, positions_);
+      break;
+    case Kernel::SSE2:
+      scan_sse2(json.data(), json.size(), scanner, positions_);
+      break;
+#endif
+    default:
+      scan_scalar(json.data(), json.size(), scanner, positions_);
+      break;
+  }
+
+  valid_ = !scanner.in_string();
+  if (!valid_) positions_.clear();
+  return valid_;
+}
@@ -0,0 +1,191 @@
+#include "JsonTape.hh"
+
+EJsonType JsonTapeRef::get_type() const {
+  switch (tag()) {
+    case 'n':
+      return EJsonType::JSON_NULL;
+    case 't':
+      return EJsonType::JSON_TRUE;
+    case 'f':
+      return EJsonType::JSON_FALSE;
+    case 'd':
+      return EJsonType::JSON_NUMBER;
+    case 'l':
+      return EJsonType::JSON_INT64;
+    case 'u':
+      return EJsonType::JSON_UINT64;
+    case '"':
+      return EJsonType::JSON_STRING;
+    case '[':
+      return EJsonType::JSON_ARRAY;
+    case '{':
+      return EJsonType::JSON_OBJECT;
+    default:
+      return EJsonType::JSON_INVALID;
+  }
+}
+
+JsonTapeRef JsonTapeRef::get_array_element_by(size_t index) const {
+  BOOST_ASSERT_MSG(tag() == '[', "type is not json_array");
+  BOOST_ASSERT_MSG(index < size(), "index out of json_array");
+  size_t curr = index_ + 1;
+  for (; index != 0; index--) curr = tape_->next_of(curr);
+  return JsonTapeRef(tape_, curr);
+}
+
+JsonTapeRef JsonTapeRef::get_object_element_by(std::string_view key) const {
+  BOOST_ASSERT_MSG(tag() == '{', "type is not json_object");
+  // 和DOM一样，重复的key取最后一个，所以要走完整个对象
+  size_t end = tape_->next_of(index_) - 1;
+  size_t found = end;
+  for (size_t curr = index_ + 1; curr != end;) {
+    size_t value = curr + 1;
+    if (JsonTapeRef(tape_, curr).get_string() == key) found = value;
+    curr = tape_->next_of(value);
+  }
+  BOOST_ASSERT_MSG(found != end, "key not exist, please check key spelling");
+  return JsonTapeRef(tape_, found);
+}
+
+size_t JsonTapeRef::size() const {
+  BOOST_ASSERT_MSG(tag() == '[' || tag() == '{',
+                   "type is not json_array or json_object");
+  size_t count = (tape_->payload_at(index_) >> 32) & JsonTape::kCountMask;
+  if (count < JsonTape::kCountMask) return count;
+  // 个数存不下时只能数一遍
+  count = 0;
+  size_t end = tape_->next_of(index_) - 1;
+  for (size_t curr = index_ + 1; curr != end; curr = tape_->next_of(curr))
+    count++;
+  return tag() == '{' ? count / 2 : count;
+}
+
+JsonTapeRef::Iterator JsonTapeRef::begin() const {
+  BOOST_ASSERT_MSG(tag() == '[', "type is not json_array");
+  return Iterator(tape_, index_ + 1);
+}
+
+JsonTapeRef::Iterator JsonTapeRef::end() const {
+  BOOST_ASSERT_MSG(tag() == '[', "type is not json_array");
+  return Iterator(tape_, tape_->next_of(index_) - 1);
+}
+
+std::string_view JsonTapeRef::get_string() const {
+  BOOST_ASSERT_MSG(tag() == '"', "type is not json_string");
+  size_t offset = tape_->payload_at(index_);
+  uint32_t len;
+  memcpy(&len, tape_->strings_.data() + offset, sizeof(len));
+  return std::string_view(tape_->strings_.data() + offset + sizeof(len), len);
+}
+
+void *JsonTapeRef::get_null() const {
+  BOOST_ASSERT_MSG(tag() == 'n', "type is not json_null");
+  return nullptr;
+}
+
+bool JsonTapeRef::get_boolean() const {
+  BOOST_ASSERT_MSG(tag() == 't' || tag() == 'f', "type is not json_bool");
+  return tag() == 't';
+}
+
+double JsonTapeRef::get_number() const {
+  BOOST_ASSERT_MSG(is_number(), "type is not json_number");
+  uint64_t bits = tape_->tape_[index_ + 1];
+  if (tag() == 'l') return static_cast<double>(static_cast<int64_t>(bits));
+  if (tag() == 'u') return static_cast<double>(bits);
+  double num;
+  memcpy(&num, &bits, sizeof(num));
+  return num;
+}
+
+int64_t JsonTapeRef::get_int64() const {
+  BOOST_ASSERT_MSG(tag() == 'l', "type is not json_int64");
+  return static_cast<int64_t>(tape_->tape_[index_ + 1]);
+}
+
+uint64_t JsonTapeRef::get_uint64() const {
+  BOOST_ASSERT_MSG(tag() == 'u' || tag() == 'l', "type is not json_uint64");
+  BOOST_ASSERT_MSG(tag() == 'u' || int64_t(tape_->tape_[index_ + 1]) >= 0,
+                   "json_int64 is negative");
+  return tape_->tape_[index_ + 1];
+}
+
+// 容器开始时先占一个字，结束时用事件带来的个数回填
+class JsonTape::Builder {
+ public:
+  Builder(JsonTape &tape, std::vector<size_t> &starts)
+      : tape_(tape), starts_(starts) {
+    starts_.clear();
+  }
+
+  bool null() {
+    tape_.append('n');
+    return true;
+  }
+  bool boolean(bool b) {
+    tape_.append(b ? 't' : 'f');
+    return true;
+  }
+  bool number(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    tape_.append('d');
+    tape_.tape_.push_back(bits);
+    return true;
+  }
+  bool int64(int64_t i) {
+    tape_.append('l');
+    tape_.tape_.push_back(static_cast<uint64_t>(i));
+    return true;
+  }
+  bool uint64(uint64_t u) {
+    tape_.append('u');
+    tape_.tape_.push_back(u);
+    return true;
+  }
+  bool string(std::string_view str) {
+    auto &strings = tape_.strings_;
+    auto len = static_cast<uint32_t>(str.size());
+    tape_.append('\"', strings.size());
+    strings.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    strings.append(str.data(), str.size());
+    return true;
+  }
+  bool key(std::string_view str) { return string(str); }
+  bool start_object() { return start('{'); }
+  bool end_object(size_t count) { return end('}', count); }
+  bool start_array() { return start('['); }
+  bool end_array(size_t count) { return end(']', count); }
+
+ private:
+  bool start(char tag) {
+    starts_.push_back(tape_.tape_.size());
+    tape_.append(tag);
+    return true;
+  }
+  bool end(char tag, size_t count) {
+    tape_.close_container(starts_.back(), tag, count);
+    starts_.pop_back();
+    return true;
+  }
+
+  JsonTape &tape_;
+  std::vector<size_t> &starts_;
+};
+
+// 和DOM共用JsonParse的事件引擎，语法和错误码一致
+JParseError JsonParser::parse(std::string_view str, JsonTape &tape) {
+  tape.clear();
+  if (str.size() > JsonTape::kMaxDocumentSize)
+    return JSON_PARSE_DOCUMENT_TOO_LARGE;
+  reset_context(str.data(), str.size(), std::pmr::new_delete_resource());
+  tape.append('r');
+  JsonTape::Builder builder(tape, tape_stack_);
+  JParseError ret = parse_events(builder);
+  if (ret != JSON_PARSE_OK) {
+    tape.clear();
+    return ret;
+  }
+  tape.tape_[0] |= tape.tape_.size();
+  return JSON_PARSE_OK;
+}
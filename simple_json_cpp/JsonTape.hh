@@ -0,0 +1,147 @@
+#pragma once
+#include "JsonParse.hh"
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+// simdjson风格的tape：整个文档是一段连续的64位字，高8位是类型标记，低56位是负载
+//   'r'        第0个字，负载是tape的长度
+//   'n' 't' 'f'
+//   'd'        下一个字是double的二进制位
+//   'l' 'u'    下一个字是int64/uint64
+//   '"'        负载是字符串在strings_里的偏移，那里先放4字节长度再放内容
+//   '[' '{'    负载低32位是对应']' '}'之后的位置，再往上24位是元素个数
+//   ']' '}'    负载是对应'[' '{'的位置
+// 对象的成员按 key value key value 的顺序排在'{'和'}'之间
+// 只读遍历时没有指针跳转，跳过一个容器只需要读一个字
+// 字符串长度和跳转位置都只有32位，超过kMaxDocumentSize的输入直接报
+// JSON_PARSE_DOCUMENT_TOO_LARGE
+class JsonTapeRef;
+
+class JsonTape {
+  friend JsonParser;
+  friend JsonTapeRef;
+
+ public:
+  // 每个值在原文里至少占1字节(数组元素算上逗号)，在tape里至多占2个字，
+  // 再加上'r'和根的数字，tape的字数不超过输入长度+2；字符串不会比输入长
+  static constexpr size_t kMaxDocumentSize = 0xFFFFFFFF - 2;
+
+  JsonTapeRef root() const;
+
+  void clear() {
+    tape_.clear();
+    strings_.clear();
+  }
+  // tape占用的字数
+  [[nodiscard]] size_t size() const { return tape_.size(); }
+
+ private:
+  static constexpr int kTagShift = 56;
+  static constexpr uint64_t kPayloadMask = (uint64_t(1) << kTagShift) - 1;
+  static constexpr uint64_t kCountMask = 0xFFFFFF;
+
+  // 解析事件到tape的handler，实现在JsonTape.cc
+  class Builder;
+
+  [[nodiscard]] char tag_at(size_t index) const {
+    return static_cast<char>(tape_[index] >> kTagShift);
+  }
+  [[nodiscard]] uint64_t payload_at(size_t index) const {
+    return tape_[index] & kPayloadMask;
+  }
+  void append(char tag, uint64_t payload = 0) {
+    tape_.push_back((uint64_t(uint8_t(tag)) << kTagShift) | payload);
+  }
+  // 回填start处的'['或'{'，并在末尾放上对应的']'或'}'
+  void close_container(size_t start, char close_tag, uint64_t count) {
+    append(close_tag, start);
+    BOOST_ASSERT_MSG(tape_.size() <= 0xFFFFFFFF, "tape jump overflow");
+    if (count > kCountMask) count = kCountMask;
+    tape_[start] |= (count << 32) | tape_.size();
+  }
+  // 跳过index处的值，返回下一个值的位置
+  [[nodiscard]] size_t next_of(size_t index) const {
+    switch (tag_at(index)) {
+      case '[':
+      case '{':
+        return payload_at(index) & 0xFFFFFFFF;
+      case 'd':
+      case 'l':
+      case 'u':
+        return index + 2;
+      default:
+        return index + 1;
+    }
+  }
+
+  std::vector<uint64_t> tape_;
+  std::string strings_;
+};
+
+// tape上某个值的只读引用，接口与JsonType保持一致
+class JsonTapeRef {
+  friend JsonTape;
+
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = JsonTapeRef;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = JsonTapeRef;
+
+    JsonTapeRef operator*() const { return JsonTapeRef(tape_, index_); }
+    Iterator &operator++() {
+      index_ = tape_->next_of(index_);
+      return *this;
+    }
+    bool operator==(const Iterator &rhs) const { return index_ == rhs.index_; }
+    bool operator!=(const Iterator &rhs) const { return index_ != rhs.index_; }
+
+   private:
+    friend JsonTapeRef;
+    Iterator(const JsonTape *tape, size_t index) : tape_(tape), index_(index) {}
+    const JsonTape *tape_;
+    size_t index_;
+  };
+
+  [[nodiscard]] EJsonType get_type() const;
+
+  JsonTapeRef operator[](size_t index) const {
+    return get_array_element_by(index);
+  }
+  [[nodiscard]] JsonTapeRef get_array_element_by(size_t index) const;
+  [[nodiscard]] JsonTapeRef get_object_element_by(std::string_view key) const;
+  // 数组或对象的元素个数
+  [[nodiscard]] size_t size() const;
+
+  // 遍历数组的元素
+  [[nodiscard]] Iterator begin() const;
+  [[nodiscard]] Iterator end() const;
+
+  [[nodiscard]] std::string_view get_string() const;
+  [[nodiscard]] void *get_null() const;
+  [[nodiscard]] bool get_boolean() const;
+  [[nodiscard]] bool is_number() const {
+    return tag() == 'd' || tag() == 'l' || tag() == 'u';
+  }
+  [[nodiscard]] double get_number() const;
+  [[nodiscard]] int64_t get_int64() const;
+  [[nodiscard]] uint64_t get_uint64() const;
+
+ private:
+  JsonTapeRef(const JsonTape *tape, size_t index)
+      : tape_(tape), index_(index) {}
+  [[nodiscard]] char tag() const { return tape_->tag_at(index_); }
+
+  const JsonTape *tape_;
+  size_t index_;
+};
+
+inline JsonTapeRef JsonTape::root() const {
+  BOOST_ASSERT_MSG(tape_.size() > 1, "tape is empty");
+  return JsonTapeRef(this, 1);
+}
@@ -0,0 +1,236 @@
+#include "JsonWriter.hh"
+
+#include <cmath>
+
+#include "leptdtoa.h"
+
+namespace {
+// 需要转义的字节写成什么，0表示写成\u00XX
+constexpr char escape_of(unsigned char c) {
+  switch (c) {
+    case '\"':
+      return '\"';
+    case '\\':
+      return '\\';
+    case '\b':
+      return 'b';
+    case '\f':
+      return 'f';
+    case '\n':
+      return 'n';
+    case '\r':
+      return 'r';
+    case '\t':
+      return 't';
+    default:
+      return 0;
+  }
+}
+}  // namespace
+
+std::string_view JsonWriter::write(const JsonType &value) {
+  external_ = false;
+  begin_ = cur_ = buffer_.get();
+  end_ = begin_ + capacity_;
+  write_document(value);
+  return std::string_view(begin_, cur_ - begin_);
+}
+
+size_t JsonWriter::write(const JsonType &value, char *out, size_t capacity) {
+  external_ = true;
+  begin_ = cur_ = out;
+  end_ = out + capacity;
+  write_document(value);
+  return cur_ - begin_;
+}
+
+void JsonWriter::grow(size_t size) {
+  size_t used = cur_ - begin_;
+  if (external_) {
+    // 调用者的buffer不够，之后都写在自己的buffer里
+    external_ = false;
+    if (capacity_ < used + size) {
+      capacity_ = std::max(capacity_ * 2, used + size);
+      buffer_.reset(new char[capacity_]);
+    }
+    if (used != 0) memcpy(buffer_.get(), begin_, used);
+  } else {
+    capacity_ = std::max({capacity_ * 2, used + size, size_t(256)});
+    std::unique_ptr<char[]> buffer(new char[capacity_]);
+    if (used != 0) memcpy(buffer.get(), begin_, used);
+    buffer_ = std::move(buffer);
+  }
+  begin_ = buffer_.get();
+  cur_ = begin_ + used;
+  end_ = begin_ + capacity_;
+}
+
+// 标量元素和成员在内层循环里连续写完，只有非空的容器才压栈
+void JsonWriter::write_document(const JsonType &value) {
+  frames_.clear();
+  write_value(value);
+  while (!frames_.empty()) {
+    // write_value可能压栈，frames_.back()在这之后就失效了，先拷一份
+    Frame frame = frames_.back();
+    bool nested = false;
+    if (frame.object) {
+      auto member = static_cast<const JsonMember *>(frame.next);
+      auto end = static_cast<const JsonMember *>(frame.end);
+      for (; member != end; member++) {
+        if (!frame.first) put(',');
+        frame.first = false;
+        write_string(member->key());
+        put(':');
+        if (is_container(member->value)) {
+          frames_.back() = {member + 1, end, true, false};
+          write_value(member->value);
+          nested = true;
+          break;
+        }
+        write_scalar(member->value);
+      }
+    } else {
+      auto element = static_cast<const JsonType *>(frame.next);
+      auto end = static_cast<const JsonType *>(frame.end);
+      for (; element != end; element++) {
+        if (!frame.first) put(',');
+        frame.first = false;
+        if (is_container(*element)) {
+          frames_.back() = {element + 1, end, false, false};
+          write_value(*element);
+          nested = true;
+          break;
+        }
+        write_scalar(*element);
+      }
+    }
+    if (!nested) {
+      put(frame.object ? '}' : ']');
+      frames_.pop_back();
+    }
+  }
+}
+
+void JsonWriter::write_value(const JsonType &value) {
+  switch (value.type_) {
+    case EJsonType::JSON_ARRAY: {
+      JsonArrayBlock *block = value.array_block();
+      if (block == nullptr || block->size == 0) {
+        put("[]", 2);
+        break;
+      }
+      put('[');
+      const JsonType *elements = block->elements();
+      frames_.push_back({elements, elements + block->size, false, true});
+      break;
+    }
+    case EJsonType::JSON_OBJECT: {
+      JsonObjectBlock *block = value.object_block();
+      if (block == nullptr || block->size == 0) {
+        put("{}", 2);
+        break;
+      }
+      put('{');
+      const JsonMember *members = block->members();
+      frames_.push_back({members, members + block->size, true, true});
+      break;
+    }
+    default:
+      write_scalar(value);
+      break;
+  }
+}
+
+void JsonWriter::write_scalar(const JsonType &value) {
+  switch (value.type_) {
+    case EJsonType::JSON_NULL:
+      put("null", 4);
+      break;
+    case EJsonType::JSON_TRUE:
+      put("true", 4);
+      break;
+    case EJsonType::JSON_FALSE:
+      put("false", 5);
+      break;
+    case EJsonType::JSON_NUMBER:
+    case EJsonType::JSON_INT64:
+    case EJsonType::JSON_UINT64:
+      write_number(value);
+      break;
+    case EJsonType::JSON_STRING:
+      write_string(value.get_string_view());
+      break;
+    default:
+      BOOST_ASSERT_MSG(false, "invalid json value");
+      break;
+  }
+}
+
+// 不需要转义的一段直接拷贝，SIMD一次找16/32个字节
+// 每次只预留确实要写的字节，调用者的buffer放得下时不会挪到自己的buffer里
+void JsonWriter::write_string(std::string_view str) {
+  static const char kHex[] = "0123456789ABCDEF";
+  const char *p = str.data();
+  const char *end = p + str.size();
+  put('\"');
+  for (;;) {
+    const char *special = JsonSimd::find_string_special(p, end);
+    if (special == end) {
+      // 最后一段连同结尾的引号
+      size_t size = end - p;
+      char *out = reserve(size + 1);
+      memcpy(out, p, size);
+      out[size] = '\"';
+      cur_ = out + size + 1;
+      return;
+    }
+    put(p, special - p);
+    auto c = static_cast<unsigned char>(*special);
+    char escape = escape_of(c);
+    if (escape != 0) {
+      char *out = reserve(2);
+      out[0] = '\\';
+      out[1] = escape;
+      cur_ = out + 2;
+    } else {
+      char *out = reserve(6);
+      memcpy(out, "\\u00", 4);
+      out[4] = kHex[c >> 4];
+      out[5] = kHex[c & 0xF];
+      cur_ = out + 6;
+    }
+    p = special + 1;
+  }
+}
+
+// 自己的buffer先预留最长的数字，直接格式化到cur_
+// 调用者的buffer剩得不多时先写到栈上再拷贝，只预留实际的长度，放得下就不会挪到自己的buffer里
+// JSON没有NaN和无穷大，写成null；数字的格式和lept_json_c的lept_stringify相同，见leptdtoa.h
+void JsonWriter::write_number(const JsonType &value) {
+  if (!external_) reserve(LEPT_DTOA_BUFFER_SIZE);
+  char buf[LEPT_DTOA_BUFFER_SIZE];
+  char *first = end_ - cur_ >= LEPT_DTOA_BUFFER_SIZE ? cur_ : buf;
+  char *last;
+  switch (value.type_) {
+    case EJsonType::JSON_INT64:
+      last = lept_i64toa(value.load<int64_t>(), first);
+      break;
+    case EJsonType::JSON_UINT64:
+      last = lept_u64toa(value.load<uint64_t>(), first);
+      break;
+    default: {
+      auto number = value.load<double>();
+      if (!std::isfinite(number)) {
+        put("null", 4);
+        return;
+      }
+      last = lept_dtoa(number, first);
+      break;
+    }
+  }
+  if (first == cur_) {
+    cur_ = last;
+  } else {
+    put(buf, last - buf);
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "JsonParse.hh"
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// 把JsonType写成紧凑的JSON文本
+// 所有输出追加到同一块buffer，按需成倍扩容，同一个writer反复使用时不再分配：
+//   JsonWriter writer;
+//   std::string_view text = writer.write(doc.root());
+// 不递归，嵌套多深都只占frames_的空间
+class JsonWriter {
+ public:
+  // 写进writer自己的buffer，返回的view在下一次write之前有效
+  std::string_view write(const JsonType &value);
+  // 写进调用者的buffer，返回需要的字节数，和snprintf一样不写结尾的'\0'
+  // 返回值大于capacity时out里的内容不完整，需要换一个够大的buffer重写
+  size_t write(const JsonType &value, char *out, size_t capacity);
+
+  // 自己的buffer已经分配的字节数
+  [[nodiscard]] size_t capacity() const { return capacity_; }
+
+ private:
+  // 一个还没有写完的容器，next/end指向剩下的元素或成员
+  struct Frame {
+    const void *next;
+    const void *end;
+    bool object;
+    bool first;
+  };
+
+  void write_document(const JsonType &value);
+  // 标量直接写出，容器写出开头的括号并压栈
+  void write_value(const JsonType &value);
+  void write_scalar(const JsonType &value);
+  static bool is_container(const JsonType &value) {
+    return value.type_ == EJsonType::JSON_ARRAY || value.type_ == EJsonType::JSON_OBJECT;
+  }
+  void write_string(std::string_view str);
+  void write_number(const JsonType &value);
+
+  // 保证至少还有size个字节可写
+  char *reserve(size_t size) {
+    if (static_cast<size_t>(end_ - cur_) < size) grow(size);
+    return cur_;
+  }
+  void put(char c) { *reserve(1) = c; cur_++; }
+  void put(const char *str, size_t size) {
+    memcpy(reserve(size), str, size);
+    cur_ += size;
+  }
+  // 调用者的buffer写满了就把已写的部分搬到自己的buffer里接着写完，算出需要的长度
+  void grow(size_t size);
+
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_{0};
+  char *begin_{nullptr};
+  char *cur_{nullptr};
+  char *end_{nullptr};
+  bool external_{false};
+  std::vector<Frame> frames_;
+};
@@ -0,0 +1,1173 @@
+// 性能测试
+// 用法: simple_json_bench [case] [size_mb]
+//   case: dom(默认) tape structural string number dfa ondemand sax stream many parallel small
+//         object pretty stringify
+#include "JsonBatch.hh"
+#include "JsonNumber.hh"
+#include "JsonOnDemand.hh"
+#include "JsonParse.hh"
+#include "JsonStream.hh"
+#include "JsonStructural.hh"
+#include "JsonTape.hh"
+#include "JsonWriter.hh"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+extern "C" {
+#include "leptjson.h"
+}
+#include "leptdtoa.h"
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// 原来JsonParse里逐位累加double的数字解析，留作对比的基线
+class ParseNumHelper {
+  enum class ResNumStatus {
+    INTEGRAL,
+    FRACTIONAL,
+    EXPONENTIAL,
+  };
+
+ public:
+  ParseNumHelper() { reset(); }
+  void reset() {
+    integral_part_ = 0;
+    fractional_part_ = 0;
+    exponential_part_ = 0;
+    integral_part_flag_ = 1;
+    exponential_part_flag_ = 1;
+    K = 0.1;
+
+    set_integral_status();
+  }
+  double get_num() const {
+    double res = integral_part_flag_ * (integral_part_ + fractional_part_) *
+                 pow(10, exponential_part_flag_ * exponential_part_);
+    return res;
+  }
+  void calc_number(int curr_num) {
+    switch (num_status_) {
+      case ResNumStatus::INTEGRAL:
+        integral_part_ = integral_part_ * 10 + curr_num;
+        break;
+      case ResNumStatus::FRACTIONAL:
+        fractional_part_ = fractional_part_ + (curr_num)*K;
+        K = K * 0.1;
+        break;
+      case ResNumStatus::EXPONENTIAL:
+        exponential_part_ = exponential_part_ * 10 + curr_num;
+        break;
+      default:
+        break;
+    }
+  }
+  void set_exponential_flag() { exponential_part_flag_ = -1; }
+  void set_integral_flag() { integral_part_flag_ = -1; }
+  void set_fractional_status() { num_status_ = ResNumStatus::FRACTIONAL; }
+  void set_exponential_status() { num_status_ = ResNumStatus::EXPONENTIAL; }
+
+ private:
+  double K = 0.1;
+  void set_integral_status() { num_status_ = ResNumStatus::INTEGRAL; }
+  int integral_part_flag_{1};
+  int exponential_part_flag_{1};
+  double integral_part_{};
+  double fractional_part_{};
+  double exponential_part_{};
+  ResNumStatus num_status_{ResNumStatus::INTEGRAL};
+};
+
+// 当前进程的常驻内存(KB)
+long current_rss_kb() {
+#ifdef __linux__
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) return 0;
+  if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+  return 0;
+#endif
+}
+
+// 在子进程里跑一次f，返回f执行前后常驻内存的增量(KB)
+// 放到子进程里是为了不受前面测试留下的空闲堆内存影响
+template <typename F>
+long measure_rss_kb(F &&f) {
+#ifdef __linux__
+  int fds[2];
+  if (pipe(fds) != 0) return 0;
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    long base = current_rss_kb();
+    long delta = f(base);
+    ssize_t n = write(fds[1], &delta, sizeof(delta));
+    _exit(n == sizeof(delta) ? 0 : 1);
+  }
+  close(fds[1]);
+  long delta = 0;
+  if (read(fds[0], &delta, sizeof(delta)) != sizeof(delta)) delta = 0;
+  close(fds[0]);
+  waitpid(pid, nullptr, 0);
+  return delta;
+#else
+  (void)f;
+  return 0;
+#endif
+}
+
+// 原来JsonParse里的数字状态机：每个字节都按值拷贝一次std::map再查找
+struct LegacyNumberScanner {
+  enum class NumberState {
+    NEGATIVE,
+    POSITIVE,
+    ZERO,
+    DIGIT1_9,
+    DIGIT,
+    STATUS_E,
+    POINT,
+    E_AFTER_N,
+    START,
+    INVALID,
+  };
+  static int get_state_index(char x) {
+    if (x > '0' && x <= '9') return 3;
+    switch (x) {
+      case '-':
+        return 0;
+      case '+':
+        return 1;
+      case '0':
+        return 2;
+      case 'e':
+      case 'E':
+        return 5;
+      case '.':
+        return 6;
+      default:
+        return -1;
+    }
+  }
+  using TableType = std::map<NumberState, std::array<NumberState, 8>>;
+  static TableType get_status_table() {
+    static TableType table = {
+        /*0 stands for NEGATIVE */
+        /*1 stands for POSITIVE */
+        /*2 stands for ZERO */
+        /*3 stands for DIGIT1_9*/
+        /*4 stands for DIGIT*/
+        /*5 stands for STATUS_E*/
+        /*6 stands for POINT*/
+        /*7 stands for E_A_N*/
+        {NumberState::START,
+         {NumberState::NEGATIVE, NumberState::INVALID, NumberState::ZERO,
+          NumberState::DIGIT1_9, NumberState::INVALID, NumberState::INVALID,
+          NumberState::INVALID, NumberState::INVALID}},
+        {NumberState::NEGATIVE,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::ZERO,
+          NumberState::DIGIT1_9, NumberState::INVALID, NumberState::INVALID,
+          NumberState::INVALID, NumberState::INVALID}},
+        {NumberState::POSITIVE,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
+          NumberState::INVALID, NumberState::INVALID}},
+        {NumberState::ZERO,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::STATUS_E,
+          NumberState::POINT, NumberState::INVALID}},
+        {NumberState::DIGIT1_9,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::STATUS_E,
+          NumberState::POINT, NumberState::INVALID}},
+        {NumberState::DIGIT,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::STATUS_E,
+          NumberState::POINT, NumberState::INVALID}},
+        {NumberState::STATUS_E,
+         {NumberState::E_AFTER_N, NumberState::POSITIVE, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
+          NumberState::INVALID, NumberState::INVALID}},
+        {NumberState::POINT,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
+          NumberState::INVALID, NumberState::INVALID}},
+        {NumberState::E_AFTER_N,
+         {NumberState::INVALID, NumberState::INVALID, NumberState::DIGIT,
+          NumberState::DIGIT, NumberState::DIGIT, NumberState::INVALID,
+          NumberState::INVALID, NumberState::INVALID}},
+    };
+    return table;
+  }
+
+  static const char *scan(const char *p, const char *end) {
+    NumberState curr_state = NumberState::START;
+    for (; p != end; p++) {
+      auto index_of_curr_char = get_state_index(*p);
+      if (index_of_curr_char == -1) break;
+      curr_state = get_status_table().at(curr_state).at(index_of_curr_char);
+      if (curr_state == NumberState::INVALID) return nullptr;
+    }
+    if (curr_state == NumberState::DIGIT1_9 ||
+        curr_state == NumberState::ZERO || curr_state == NumberState::DIGIT)
+      return p;
+    return nullptr;
+  }
+};
+
+// CPU的时间戳计数，不支持时返回0
+inline uint64_t cycles_now() {
+#if JSON_SIMD_X86
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// 多次运行取最快的一次，单位秒
+template <typename F>
+double best_of(int rounds, F &&f) {
+  double best = 1e100;
+  for (int i = 0; i < rounds; i++) {
+    auto start = Clock::now();
+    f();
+    std::chrono::duration<double> cost = Clock::now() - start;
+    if (cost.count() < best) best = cost.count();
+  }
+  return best;
+}
+
+// 生成一个由小对象组成的数组，返回文档里的节点数
+size_t make_records(size_t target_bytes, std::string &json) {
+  size_t nodes = 1;
+  json = "[";
+  for (size_t i = 0; json.size() < target_bytes; i++) {
+    if (i != 0) json += ",";
+    json += "{\"id\":" + std::to_string(100000 + i) +
+            ",\"name\":\"user_" + std::to_string(i) +
+            "\",\"score\":" + std::to_string(i % 1000) + ".25" +
+            ",\"active\":" + (i % 2 ? "true" : "false") +
+            ",\"tags\":[\"red\",\"green\",\"blue\"]"
+            ",\"pos\":{\"x\":1.5,\"y\":-2.75}"
+            ",\"note\":null}";
+    nodes += 14;
+  }
+  json += "]";
+  return nodes;
+}
+
+// 以长字符串为主的文档：日志行和base64，少量带转义
+std::string make_strings(size_t target_bytes) {
+  static const char kBase64[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string json = "[";
+  for (size_t i = 0; json.size() < target_bytes; i++) {
+    if (i != 0) json += ",";
+    json += "{\"msg\":\"2020-08-10 12:00:00 INFO request " + std::to_string(i) +
+            " served by worker-7 in 12ms, upstream=10.0.0.1:8080 path=/api/v1/users\"";
+    json += ",\"blob\":\"";
+    for (size_t j = 0; j < 512; j++) json += kBase64[(i * 31 + j * 7) % 64];
+    json += "\"";
+    if (i % 8 == 0) json += ",\"quoted\":\"say \\\"hi\\\"\\n\\tand leave\"";
+    json += "}";
+  }
+  json += "]";
+  return json;
+}
+
+// 按两个空格缩进重新排版，模拟上游发来的格式化JSON
+std::string pretty_print(const std::string &json) {
+  std::string out;
+  out.reserve(json.size() * 3);
+  int depth = 0;
+  bool in_string = false;
+  auto newline = [&] {
+    out += '\n';
+    out.append(depth * 2, ' ');
+  };
+  for (size_t i = 0; i < json.size(); i++) {
+    char c = json[i];
+    if (in_string) {
+      out += c;
+      if (c == '\\') out += json[++i];
+      else if (c == '"') in_string = false;
+      continue;
+    }
+    switch (c) {
+      case '"':
+        in_string = true;
+        out += c;
+        break;
+      case '{':
+      case '[':
+        out += c;
+        depth++;
+        newline();
+        break;
+      case '}':
+      case ']':
+        depth--;
+        newline();
+        out += c;
+        break;
+      case ',':
+        out += c;
+        newline();
+        break;
+      case ':':
+        out += ": ";
+        break;
+      default:
+        out += c;
+    }
+  }
+  return out;
+}
+
+// nodes、bytes、rss_kb为0的项不输出
+void report(const char *name, double seconds, size_t nodes, size_t bytes,
+            long rss_kb) {
+  printf("%-28s", name);
+  if (nodes != 0) printf(" %9.2f Mnodes/s", nodes / seconds / 1e6);
+  if (bytes != 0) printf(" %9.2f MB/s", bytes / seconds / (1024.0 * 1024.0));
+  if (rss_kb != 0) printf("   rss +%ld KB", rss_kb);
+  printf("\n");
+}
+
+// new_delete分配的树 vs JsonDocument的arena，时间包含整棵树的释放
+void bench_dom(size_t size) {
+  std::string json;
+  size_t nodes = make_records(size, json);
+  printf("dom: %zu bytes, %zu nodes\n", json.size(), nodes);
+  const int rounds = 5;
+
+  // 先量内存，这时父进程的堆里还没有测速留下的空闲内存
+  long tree_rss = measure_rss_kb([&](long base) {
+    auto res = JsonParse::parse(json);
+    return current_rss_kb() - base;
+  });
+  long doc_rss = measure_rss_kb([&](long base) {
+    JsonDocument doc;
+    JsonParse::parse(json, doc);
+    return current_rss_kb() - base;
+  });
+
+  double tree_cost = best_of(rounds, [&] {
+    auto res = JsonParse::parse(json);
+    if (res.second != JSON_PARSE_OK) abort();
+  });
+  report("new_delete tree", tree_cost, nodes, json.size(), tree_rss);
+
+  double doc_cost = best_of(rounds, [&] {
+    JsonDocument doc;
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("JsonDocument arena", doc_cost, nodes, json.size(), doc_rss);
+}
+
+// 只读遍历：JsonType树 vs tape，遍历每条记录读两个字段
+void bench_tape(size_t size) {
+  std::string json;
+  size_t nodes = make_records(size, json);
+  size_t records = (nodes - 1) / 14;
+  printf("tape: %zu bytes, %zu records\n", json.size(), records);
+  const int rounds = 5;
+
+  double dom_parse = best_of(rounds, [&] {
+    JsonDocument doc;
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonDocument", dom_parse, nodes, json.size(), 0);
+  JsonTape tape;
+  double tape_parse = best_of(rounds, [&] {
+    if (JsonParse::parse(json, tape) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonTape", tape_parse, nodes, json.size(), 0);
+
+  JsonDocument doc;
+  JsonParse::parse(json, doc);
+  double dom_sum = 0;
+  double dom_walk = best_of(rounds, [&] {
+    auto &root = doc.root();
+    for (size_t i = 0; i < records; i++) {
+      dom_sum += root[i].get_object_element_by("score").get_number();
+      dom_sum += root[i].get_object_element_by("pos").get_object_element_by("x").get_number();
+    }
+  });
+  report("walk JsonDocument", dom_walk, records, 0, 0);
+
+  double tape_sum = 0;
+  double tape_walk = best_of(rounds, [&] {
+    for (auto record : tape.root()) {
+      tape_sum += record.get_object_element_by("score").get_number();
+      tape_sum += record.get_object_element_by("pos").get_object_element_by("x").get_number();
+    }
+  });
+  report("walk JsonTape", tape_walk, records, 0, 0);
+  if (dom_sum != tape_sum) abort();
+}
+
+// stage 1的吞吐，和解析同一份格式化JSON对比
+// 串行解析不使用索引，这里的parse只是参照，索引的用处见parse_parallel
+void bench_structural(size_t size) {
+  std::string compact;
+  size_t nodes = make_records(size / 2, compact);
+  std::string json = pretty_print(compact);
+  printf("structural: %zu bytes pretty printed, %zu nodes\n", json.size(), nodes);
+  const int rounds = 5;
+
+  JsonStructuralIndex index;
+  const std::pair<const char *, JsonStructuralIndex::Kernel> kernels[] = {
+      {"stage1 scalar", JsonStructuralIndex::Kernel::SCALAR},
+      {"stage1 sse2", JsonStructuralIndex::Kernel::SSE2},
+      {"stage1 avx2", JsonStructuralIndex::Kernel::AVX2},
+  };
+  for (auto &[name, kernel] : kernels) {
+    double cost = best_of(rounds, [&] {
+      if (!index.build(json, kernel)) abort();
+    });
+    report(name, cost, 0, json.size(), 0);
+  }
+
+  JsonDocument doc;
+  double plain = best_of(rounds, [&] {
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonDocument", plain, nodes, json.size(), 0);
+}
+
+// 同一份数据紧凑和格式化两种排版，handler什么都不做，差别主要是跳过空白的开销
+class NullHandler : public JsonBaseHandler<NullHandler> {};
+void bench_pretty(size_t size) {
+  std::string compact;
+  size_t nodes = make_records(size / 2, compact);
+  std::string pretty = pretty_print(compact);
+  printf("pretty: %zu bytes compact, %zu bytes pretty printed, %zu nodes\n",
+         compact.size(), pretty.size(), nodes);
+  const int rounds = 5;
+  JsonTape tape;
+  for (auto [name, json] : {std::pair<const char *, const std::string *>{"compact", &compact},
+                            {"pretty", &pretty}}) {
+    double cost = best_of(rounds, [&] {
+      NullHandler handler;
+      if (JsonParse::parse(*json, handler) != JSON_PARSE_OK) abort();
+    });
+    report((std::string(name) + " handler").c_str(), cost, nodes, json->size(), 0);
+    cost = best_of(rounds, [&] {
+      if (JsonParse::parse(*json, tape) != JSON_PARSE_OK) abort();
+    });
+    report((std::string(name) + " JsonTape").c_str(), cost, nodes, json->size(), 0);
+  }
+}
+
+// 原地解析会改写输入，每轮都先拷贝一份，拷贝的时间也算在内
+void bench_string(size_t size) {
+  std::string json = make_strings(size);
+  printf("string: %zu bytes\n", json.size());
+  double cost = best_of(5, [&] {
+    auto res = JsonParse::parse(json);
+    if (res.second != JSON_PARSE_OK) abort();
+  });
+  report("parse tree", cost, 0, json.size(), 0);
+  std::string buf;
+  cost = best_of(5, [&] {
+    buf = json;
+    auto res = JsonParse::parse_insitu(&buf[0], buf.size());
+    if (res.second != JSON_PARSE_OK) abort();
+  });
+  report("parse_insitu tree", cost, 0, json.size(), 0);
+  cost = best_of(5, [&] {
+    auto res = JsonParse::parse_borrowed(json);
+    if (res.second != JSON_PARSE_OK) abort();
+  });
+  report("parse_borrowed tree", cost, 0, json.size(), 0);
+  JsonDocument doc;
+  cost = best_of(5, [&] {
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonDocument", cost, 0, json.size(), 0);
+  cost = best_of(5, [&] {
+    buf = json;
+    if (JsonParse::parse_insitu(&buf[0], buf.size(), doc) != JSON_PARSE_OK)
+      abort();
+  });
+  report("parse_insitu JsonDocument", cost, 0, json.size(), 0);
+  cost = best_of(5, [&] {
+    if (JsonParse::parse_borrowed(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse_borrowed JsonDocument", cost, 0, json.size(), 0);
+  // 打开UTF-8检查，再换成大部分是中文和\\u转义的文本
+  JsonParser parser;
+  parser.set_validate_utf8(true);
+  cost = best_of(5, [&] {
+    if (parser.parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonDocument validate_utf8", cost, 0, json.size(), 0);
+  std::string cjk = "[";
+  while (cjk.size() < json.size()) {
+    if (cjk.size() > 1) cjk += ",";
+    cjk += "\"";
+    for (int i = 0; i < 40; i++) cjk += "\xE4\xBD\xA0\xE5\xA5\xBD\xEF\xBC\x8C\xE4\xB8\x96\xE7\x95\x8C ";
+    cjk += "\\u4f60\\u597d\\uD83D\\uDE00\"";
+  }
+  cjk += "]";
+  parser.set_validate_utf8(false);
+  cost = best_of(5, [&] {
+    if (parser.parse(cjk, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse cjk JsonDocument", cost, 0, cjk.size(), 0);
+  parser.set_validate_utf8(true);
+  cost = best_of(5, [&] {
+    if (parser.parse(cjk, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse cjk JsonDocument validate_utf8", cost, 0, cjk.size(), 0);
+  // 只跑UTF-8检查本身，和上面的解析对比
+  cost = best_of(5, [&] {
+    if (!JsonSimd::validate_utf8(cjk.data(), cjk.data() + cjk.size())) abort();
+  });
+  report("validate_utf8 cjk", cost, 0, cjk.size(), 0);
+  cost = best_of(5, [&] {
+    if (!JsonSimd::validate_utf8(json.data(), json.data() + json.size())) abort();
+  });
+  report("validate_utf8 ascii", cost, 0, json.size(), 0);
+  JsonTape tape;
+  cost = best_of(5, [&] {
+    if (JsonParse::parse(json, tape) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonTape", cost, 0, json.size(), 0);
+}
+// 类似canada.json的经纬度坐标，每个数字都有15位左右的有效数字
+std::string make_coordinates(size_t target_bytes, std::vector<std::string> &numbers) {
+  std::string json = "[";
+  uint64_t seed = 42;
+  auto next = [&seed] {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 11;
+  };
+  char buf[32];
+  for (size_t i = 0; json.size() < target_bytes; i++) {
+    if (i != 0) json += ",";
+    double lon = -180.0 + double(next()) / double(1ULL << 53) * 360.0;
+    double lat = -90.0 + double(next()) / double(1ULL << 53) * 180.0;
+    json += "[";
+    snprintf(buf, sizeof(buf), "%.15f", lon);
+    numbers.emplace_back(buf);
+    json += buf;
+    json += ",";
+    snprintf(buf, sizeof(buf), "%.15f", lat);
+    numbers.emplace_back(buf);
+    json += buf;
+    json += "]";
+  }
+  json += "]";
+  return json;
+}
+
+double legacy_parse_number(const char *p, const char *end) {
+  ParseNumHelper helper;
+  for (; p != end; p++) {
+    switch (*p) {
+      case '-':
+        helper.set_integral_flag();
+        break;
+      case '.':
+        helper.set_fractional_status();
+        break;
+      case 'e':
+      case 'E':
+        helper.set_exponential_status();
+        if (p[1] == '-') helper.set_exponential_flag();
+        if (p[1] == '-' || p[1] == '+') p++;
+        break;
+      default:
+        helper.calc_number(*p - '0');
+    }
+  }
+  return helper.get_num();
+}
+
+// 单独转换数字：旧的逐位累加 vs strtod vs JsonNumber，以及和strtod结果不一致的个数
+void bench_number(size_t size) {
+  std::vector<std::string> numbers;
+  std::string json = make_coordinates(size, numbers);
+  size_t bytes = 0;
+  for (auto &n : numbers) bytes += n.size();
+  printf("number: %zu bytes, %zu numbers\n", json.size(), numbers.size());
+  const int rounds = 5;
+
+  std::vector<double> expected(numbers.size());
+  double cost = best_of(rounds, [&] {
+    for (size_t i = 0; i < numbers.size(); i++)
+      expected[i] = strtod(numbers[i].c_str(), nullptr);
+  });
+  report("strtod", cost, numbers.size(), bytes, 0);
+
+  std::vector<double> values(numbers.size());
+  auto mismatches = [&] {
+    size_t n = 0;
+    for (size_t i = 0; i < numbers.size(); i++) n += values[i] != expected[i];
+    return n;
+  };
+  cost = best_of(rounds, [&] {
+    for (size_t i = 0; i < numbers.size(); i++) {
+      auto &n = numbers[i];
+      values[i] = legacy_parse_number(n.data(), n.data() + n.size());
+    }
+  });
+  report("legacy ParseNumHelper", cost, numbers.size(), bytes, 0);
+  printf("  mismatches vs strtod: %zu\n", mismatches());
+  cost = best_of(rounds, [&] {
+    for (size_t i = 0; i < numbers.size(); i++) {
+      auto &n = numbers[i];
+      values[i] = JsonNumber::parse_double(n.data(), n.data() + n.size());
+    }
+  });
+  report("JsonNumber", cost, numbers.size(), bytes, 0);
+  printf("  mismatches vs strtod: %zu\n", mismatches());
+
+  JsonDocument doc;
+  cost = best_of(rounds, [&] {
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonDocument", cost, numbers.size(), json.size(), 0);
+
+  // 反过来把double写成文本，按写出的字节数算
+  std::string out(numbers.size() * LEPT_DTOA_BUFFER_SIZE, '\0');
+  size_t written = 0;
+  cost = best_of(rounds, [&] {
+    char *p = &out[0];
+    for (double d : expected) p += snprintf(p, LEPT_DTOA_BUFFER_SIZE, "%.17g", d);
+    written = p - out.data();
+  });
+  report("format %.17g", cost, numbers.size(), written, 0);
+  cost = best_of(rounds, [&] {
+    char *p = &out[0];
+    for (double d : expected) p = lept_dtoa(d, p);
+    written = p - out.data();
+  });
+  report("format lept_dtoa", cost, numbers.size(), written, 0);
+  for (size_t i = 0; i < expected.size(); i++) {
+    char buf[LEPT_DTOA_BUFFER_SIZE];
+    *lept_dtoa(expected[i], buf) = '\0';
+    if (strtod(buf, nullptr) != expected[i]) abort();
+  }
+}
+// 只扫描数字的边界，不计算数值：每个数字字节花多少个周期
+void bench_dfa(size_t size) {
+  std::vector<std::string> numbers;
+  make_coordinates(size, numbers);
+  size_t bytes = 0;
+  for (auto &n : numbers) bytes += n.size();
+  printf("dfa: %zu numbers, %zu numeric bytes\n", numbers.size(), bytes);
+
+  auto run = [&](const char *name, auto scan) {
+    uint64_t best_cycles = UINT64_MAX;
+    double cost = best_of(5, [&] {
+      uint64_t start = cycles_now();
+      for (auto &n : numbers) {
+        if (scan(n.data(), n.data() + n.size()) != n.data() + n.size()) abort();
+      }
+      best_cycles = std::min(best_cycles, cycles_now() - start);
+    });
+    report(name, cost, 0, bytes, 0);
+    if (best_cycles != 0) printf("  %.2f cycles/byte\n", double(best_cycles) / bytes);
+  };
+  run("std::map state table", LegacyNumberScanner::scan);
+  run("constexpr state table", JsonNumber::scan);
+}
+// 200个字段的宽对象，每条记录只读其中4个字段
+std::string make_wide_records(size_t target_bytes, size_t &records) {
+  std::string json = "[";
+  for (records = 0; json.size() < target_bytes; records++) {
+    if (records != 0) json += ",";
+    json += "{";
+    for (int f = 0; f < 200; f++) {
+      if (f != 0) json += ",";
+      json += "\"field_" + std::to_string(f) + "\":";
+      if (f == 100) {
+        json += "{\"id\":" + std::to_string(1000000 + records) +
+                ",\"name\":\"user_" + std::to_string(records) + "\"}";
+      } else if (f % 4 == 0) {
+        json += "\"value " + std::to_string(f) + "\"";
+      } else if (f % 4 == 1) {
+        json += std::to_string(f * 7) + ".5";
+      } else if (f % 4 == 2) {
+        json += "[1,2,{\"x\":" + std::to_string(f) + "}]";
+      } else {
+        json += std::to_string(f);
+      }
+    }
+    json += "}";
+  }
+  json += "]";
+  return json;
+}
+
+// 全部解析再取字段 vs 按需解析只碰用到的字段
+void bench_ondemand(size_t size) {
+  size_t records;
+  std::string json = make_wide_records(size, records);
+  printf("ondemand: %zu bytes, %zu records\n", json.size(), records);
+  const int rounds = 5;
+
+  int64_t expected = 0;
+  for (size_t i = 0; i < records; i++) expected += 1000000 + i + 3 + 199;
+
+  int64_t sum = 0;
+  JsonDocument doc;
+  double cost = best_of(rounds, [&] {
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+    sum = 0;
+    auto &root = doc.root();
+    for (size_t i = 0; i < records; i++) {
+      auto &record = root[i];
+      sum += record.get_object_element_by("field_100").get_object_element_by("id").get_int64();
+      sum += record.get_object_element_by("field_3").get_int64();
+      sum += record.get_object_element_by("field_199").get_int64();
+      sum += record.get_object_element_by("field_0").get_string().size() * 0;
+    }
+  });
+  if (sum != expected) abort();
+  report("JsonDocument parse + get", cost, records, json.size(), 0);
+
+  JsonTape tape;
+  cost = best_of(rounds, [&] {
+    if (JsonParse::parse(json, tape) != JSON_PARSE_OK) abort();
+    sum = 0;
+    for (auto record : tape.root()) {
+      sum += record.get_object_element_by("field_100").get_object_element_by("id").get_int64();
+      sum += record.get_object_element_by("field_3").get_int64();
+      sum += record.get_object_element_by("field_199").get_int64();
+      sum += record.get_object_element_by("field_0").get_string().size() * 0;
+    }
+  });
+  if (sum != expected) abort();
+  report("JsonTape parse + get", cost, records, json.size(), 0);
+
+  JsonOnDemand lazy;
+  cost = best_of(rounds, [&] {
+    if (JsonParse::parse(json, lazy) != JSON_PARSE_OK) abort();
+    sum = 0;
+    for (auto record : lazy.root()) {
+      sum += record["field_100"]["id"].get_int64();
+      sum += record["field_3"].get_int64();
+      sum += record["field_199"].get_int64();
+      sum += record["field_0"].get_string().size() * 0;
+    }
+  });
+  if (sum != expected) abort();
+  report("JsonOnDemand", cost, records, json.size(), 0);
+}
+// 日志转发：每条记录只取几个字段，其余的事件直接丢掉
+class RouterHandler : public JsonBaseHandler<RouterHandler> {
+ public:
+  bool int64(int64_t i) {
+    if (depth_ == 2 && (key_ == "field_3" || key_ == "field_199")) sum += i;
+    if (depth_ == 3 && in_user_ && key_ == "id") sum += i;
+    return true;
+  }
+  // key的参数只在回调期间有效，要拷贝下来
+  bool key(std::string_view key) {
+    key_.assign(key.data(), key.size());
+    return true;
+  }
+  bool start_object() {
+    depth_++;
+    in_user_ = depth_ == 3 && key_ == "field_100";
+    return true;
+  }
+  bool end_object(size_t) {
+    depth_--;
+    in_user_ = false;
+    return true;
+  }
+  bool start_array() {
+    depth_++;
+    return true;
+  }
+  bool end_array(size_t) {
+    depth_--;
+    return true;
+  }
+
+  int64_t sum = 0;
+
+ private:
+  std::string key_;
+  int depth_ = 0;
+  bool in_user_ = false;
+};
+
+// 建树再取字段 vs 事件回调里直接取字段
+void bench_sax(size_t size) {
+  size_t records;
+  std::string json = make_wide_records(size, records);
+  printf("sax: %zu bytes, %zu records\n", json.size(), records);
+  const int rounds = 5;
+
+  int64_t expected = 0;
+  for (size_t i = 0; i < records; i++) expected += 1000000 + i + 3 + 199;
+
+  int64_t sum = 0;
+  JsonDocument doc;
+  double cost = best_of(rounds, [&] {
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+    sum = 0;
+    auto &root = doc.root();
+    for (size_t i = 0; i < records; i++) {
+      auto &record = root[i];
+      sum += record.get_object_element_by("field_100").get_object_element_by("id").get_int64();
+      sum += record.get_object_element_by("field_3").get_int64();
+      sum += record.get_object_element_by("field_199").get_int64();
+    }
+  });
+  if (sum != expected) abort();
+  report("JsonDocument parse + get", cost, records, json.size(), 0);
+
+  cost = best_of(rounds, [&] {
+    RouterHandler handler;
+    if (JsonParse::parse(json, handler) != JSON_PARSE_OK) abort();
+    sum = handler.sum;
+  });
+  if (sum != expected) abort();
+  report("handler", cost, records, json.size(), 0);
+}
+// 整块解析 vs 按64KB分块喂给流式解析
+void bench_stream(size_t size) {
+  size_t records;
+  std::string json = make_wide_records(size, records);
+  printf("stream: %zu bytes, %zu records\n", json.size(), records);
+  const int rounds = 5;
+
+  int64_t expected = 0;
+  for (size_t i = 0; i < records; i++) expected += 1000000 + i + 3 + 199;
+
+  int64_t sum = 0;
+  double cost = best_of(rounds, [&] {
+    RouterHandler handler;
+    if (JsonParse::parse(json, handler) != JSON_PARSE_OK) abort();
+    sum = handler.sum;
+  });
+  if (sum != expected) abort();
+  report("whole buffer", cost, records, json.size(), 0);
+
+  for (size_t chunk : {size_t(64) << 10, size_t(4) << 10}) {
+    cost = best_of(rounds, [&] {
+      RouterHandler handler;
+      JsonStreamParser<RouterHandler> parser(handler);
+      for (size_t i = 0; i < json.size(); i += chunk) {
+        if (parser.feed(json.data() + i, std::min(chunk, json.size() - i)) != JSON_PARSE_OK)
+          abort();
+      }
+      if (parser.finish() != JSON_PARSE_OK) abort();
+      sum = handler.sum;
+    });
+    if (sum != expected) abort();
+    report(chunk == (64 << 10) ? "64KB chunks" : "4KB chunks", cost, records, json.size(), 0);
+  }
+}
+// NDJSON：自己切行逐行解析 vs parse_many
+void bench_many(size_t size) {
+  std::string json;
+  make_records(size, json);
+  // 把数组拆成每行一条记录
+  std::string ndjson;
+  size_t lines = 1;
+  for (size_t i = 1; i + 1 < json.size(); i++) {
+    if (json[i] == ',' && json[i - 1] == '}' && json[i + 1] == '{' && json[i + 2] == '\"' &&
+        json[i + 3] == 'i') {
+      ndjson += '\n';
+      lines++;
+    } else {
+      ndjson += json[i];
+    }
+  }
+  size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  printf("many: %zu bytes, %zu lines, %zu cores\n", ndjson.size(), lines, cores);
+  const int rounds = 5;
+
+  double cost = best_of(rounds, [&] {
+    size_t count = 0;
+    for (size_t begin = 0; begin < ndjson.size();) {
+      size_t end = ndjson.find('\n', begin);
+      if (end == std::string::npos) end = ndjson.size();
+      auto res = JsonParse::parse(std::string_view(ndjson).substr(begin, end - begin));
+      if (res.second != JSON_PARSE_OK) abort();
+      count++;
+      begin = end + 1;
+    }
+    if (count != lines) abort();
+  });
+  report("line by line", cost, lines, ndjson.size(), 0);
+
+  for (size_t threads : {size_t(1), cores}) {
+    cost = best_of(rounds, [&] {
+      JsonBatch batch;
+      if (JsonParse::parse_many(ndjson, batch, threads) != 0 || batch.size() != lines) abort();
+    });
+    std::string name = "parse_many " + std::to_string(threads) + " threads";
+    report(name.c_str(), cost, lines, ndjson.size(), 0);
+  }
+}
+// 一个很大的顶层数组：串行解析 vs 多线程解析
+void bench_parallel(size_t size) {
+  std::string json;
+  size_t nodes = make_records(size, json);
+  size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  printf("parallel: %zu bytes, %zu nodes, %zu cores\n", json.size(), nodes, cores);
+  const int rounds = 5;
+
+  double cost = best_of(rounds, [&] {
+    JsonDocument doc;
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+  });
+  report("parse JsonDocument", cost, nodes, json.size(), 0);
+
+  for (size_t threads : {size_t(1), size_t(2), cores}) {
+    cost = best_of(rounds, [&] {
+      JsonDocument doc;
+      if (JsonParse::parse_parallel(json, doc, threads) != JSON_PARSE_OK) abort();
+    });
+    std::string name = "parse_parallel " + std::to_string(threads) + " threads";
+    report(name.c_str(), cost, nodes, json.size(), 0);
+  }
+}
+// RPC场景：一个线程反复解析大量小文档
+void bench_small(size_t size) {
+  std::vector<std::string> docs;
+  size_t bytes = 0;
+  for (size_t i = 0; bytes < size / 16; i++) {
+    docs.push_back("{\"method\":\"user.get\",\"id\":" + std::to_string(i) +
+                   ",\"params\":{\"uid\":" + std::to_string(100000 + i) +
+                   ",\"fields\":[\"name\",\"avatar\",\"level\"],\"trace\":\"a\\/b\"}}");
+    bytes += docs.back().size();
+  }
+  printf("small: %zu documents, %zu bytes\n", docs.size(), bytes);
+  const int rounds = 5;
+
+  double cost = best_of(rounds, [&] {
+    for (auto &doc : docs) {
+      if (JsonParse::parse(doc).second != JSON_PARSE_OK) abort();
+    }
+  });
+  report("JsonParse::parse", cost, docs.size(), bytes, 0);
+
+  cost = best_of(rounds, [&] {
+    JsonParser parser(true);
+    for (auto &doc : docs) {
+      if (parser.parse(doc).second != JSON_PARSE_OK) abort();
+    }
+  });
+  report("JsonParser use_arena", cost, docs.size(), bytes, 0);
+
+  cost = best_of(rounds, [&] {
+    JsonParser parser;
+    JsonDocument json_doc;
+    for (auto &doc : docs) {
+      if (parser.parse(doc, json_doc) != JSON_PARSE_OK) abort();
+    }
+  });
+  report("JsonParser + JsonDocument", cost, docs.size(), bytes, 0);
+
+  // 每个文档的key都一样，放进池里只存一份
+  JsonKeyPool pool;
+  cost = best_of(rounds, [&] {
+    JsonParser parser;
+    parser.set_key_pool(&pool);
+    JsonDocument json_doc;
+    for (auto &doc : docs) {
+      if (parser.parse(doc, json_doc) != JSON_PARSE_OK) abort();
+    }
+  });
+  report("JsonParser + JsonKeyPool", cost, docs.size(), bytes, 0);
+}
+// 原来的对象表示：每个对象一个unordered_map，key拷贝进arena，作为对比的基线
+class MapHandler : public JsonBaseHandler<MapHandler> {
+ public:
+  using Map = std::pmr::unordered_map<std::string_view, double>;
+
+  explicit MapHandler(JsonArena &arena) : arena_(arena) {}
+  bool number(double d) {
+    maps.back().emplace(key_, d);
+    return true;
+  }
+  bool key(std::string_view key) {
+    auto *data = static_cast<char *>(arena_.allocate(key.size(), 1));
+    memcpy(data, key.data(), key.size());
+    key_ = std::string_view(data, key.size());
+    return true;
+  }
+  bool start_object() {
+    maps.emplace_back(&arena_);
+    return true;
+  }
+
+  std::vector<Map> maps;
+
+ private:
+  JsonArena &arena_;
+  std::string_view key_;
+};
+// 小/中/宽三种对象：建对象和按key查找的开销，成员向量 vs unordered_map
+void bench_object(size_t size) {
+  const int rounds = 5;
+  for (size_t width : {size_t(4), size_t(32), size_t(512)}) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < width; i++) keys.push_back("field_" + std::to_string(i));
+    std::string json = "[";
+    size_t objects = 0;
+    for (; json.size() < size / 4; objects++) {
+      json += objects != 0 ? ",{" : "{";
+      for (size_t i = 0; i < width; i++) {
+        if (i != 0) json += ",";
+        json += "\"" + keys[i] + "\":" + std::to_string(i);
+      }
+      json += "}";
+    }
+    json += "]";
+    size_t members = objects * width;
+    printf("object: %zu members x %zu objects, %zu bytes\n", width, objects,
+           json.size());
+
+    double cost = best_of(rounds, [&] {
+      JsonDocument doc;
+      if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+    });
+    report("build member vector", cost, members, json.size(), 0);
+    cost = best_of(rounds, [&] {
+      JsonArena arena;
+      MapHandler handler(arena);
+      if (JsonParse::parse(json, handler) != JSON_PARSE_OK) abort();
+    });
+    report("build unordered_map", cost, members, json.size(), 0);
+
+    JsonDocument doc;
+    JsonParse::parse(json, doc);
+    double sum = 0;
+    cost = best_of(rounds, [&] {
+      for (size_t i = 0; i < objects; i++) {
+        JsonType &object = doc.root()[i];
+        for (auto &key : keys) sum += object.get_object_element_by(key).get_number();
+      }
+    });
+    report("lookup member vector", cost, members, 0, 0);
+    std::vector<JsonKey> handles(keys.begin(), keys.end());
+    cost = best_of(rounds, [&] {
+      for (size_t i = 0; i < objects; i++) {
+        JsonType &object = doc.root()[i];
+        for (auto &key : handles) sum += object[key].get_number();
+      }
+    });
+    report("lookup JsonKey", cost, members, 0, 0);
+    JsonArena arena;
+    MapHandler handler(arena);
+    JsonParse::parse(json, handler);
+    cost = best_of(rounds, [&] {
+      for (auto &map : handler.maps) {
+        for (auto &key : keys) sum += map.find(key)->second;
+      }
+    });
+    report("lookup unordered_map", cost, members, 0, 0);
+    if (sum < 0) printf("%f\n", sum);
+  }
+}
+// 生成器的吞吐，按输出的字节数算；lept_stringify每次都malloc一块新的buffer
+void bench_stringify(size_t size) {
+  std::string records;
+  make_records(size, records);
+  std::vector<std::string> numbers;
+  const std::pair<const char *, std::string> docs[] = {
+      {"records", records},
+      {"strings", make_strings(size)},
+      {"coordinates", make_coordinates(size, numbers)},
+  };
+  const int rounds = 5;
+  JsonWriter writer;
+  JsonDocument doc;
+  for (auto &[name, json] : docs) {
+    if (JsonParse::parse(json, doc) != JSON_PARSE_OK) abort();
+    lept_value lept;
+    lept_init(&lept);
+    if (lept_parse(&lept, json.c_str()) != LEPT_PARSE_OK) abort();
+    size_t bytes = writer.write(doc.root()).size();
+    printf("stringify %s: %zu bytes in, %zu bytes out\n", name, json.size(), bytes);
+
+    double cost = best_of(rounds, [&] {
+      if (writer.write(doc.root()).size() != bytes) abort();
+    });
+    report("JsonWriter", cost, 0, bytes, 0);
+    std::vector<char> out(bytes);
+    cost = best_of(rounds, [&] {
+      if (writer.write(doc.root(), out.data(), out.size()) != bytes) abort();
+    });
+    report("JsonWriter caller buffer", cost, 0, bytes, 0);
+    cost = best_of(rounds, [&] {
+      if (JsonParse::stringfy(doc.root()).size() != bytes) abort();
+    });
+    report("JsonParse::stringfy", cost, 0, bytes, 0);
+    size_t lept_bytes = 0;
+    cost = best_of(rounds, [&] {
+      char *str = lept_stringify(&lept, &lept_bytes);
+      free(str);
+    });
+    report("lept_stringify", cost, 0, lept_bytes, 0);
+    lept_free(&lept);
+  }
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string name = argc > 1 ? argv[1] : "dom";
+  size_t size = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 16) << 20;
+
+  if (name == "dom") {
+    bench_dom(size);
+  } else if (name == "tape") {
+    bench_tape(size);
+  } else if (name == "structural") {
+    bench_structural(size);
+  } else if (name == "string") {
+    bench_string(size);
+  } else if (name == "number") {
+    bench_number(size);
+  } else if (name == "dfa") {
+    bench_dfa(size);
+  } else if (name == "ondemand") {
+    bench_ondemand(size);
+  } else if (name == "sax") {
+    bench_sax(size);
+  } else if (name == "stream") {
+    bench_stream(size);
+  } else if (name == "many") {
+    bench_many(size);
+  } else if (name == "parallel") {
+    bench_parallel(size);
+  } else if (name == "small") {
+    bench_small(size);
+  } else if (name == "object") {
+    bench_object(size);
+  } else if (name == "pretty") {
+    bench_pretty(size);
+  } else if (name == "stringify") {
+    bench_stringify(size);
+  } else {
+    fprintf(stderr, "unknown case: %s\n", name.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -1,5 +1,14 @@
 #include "boost/test/minimal.hpp"
+#include "JsonBatch.hh"
+#include "JsonOnDemand.hh"
 #include "JsonParse.hh"
+#include "JsonStream.hh"
+#include "JsonStructural.hh"
+#include "JsonTape.hh"
+#include "JsonWriter.hh"
+#include "leptdtoa.h"
+
+#include <charconv>
 
 
 #define TEST_PARSE_ERROR(err, str)\
@@ -14,7 +23,15 @@
         JsonParse jp; \
         auto [json_value, json_err] = jp.parse(str); \
         BOOST_CHECK(json_err == JParseError::JSON_PARSE_OK); \
-        BOOST_CHECK(json_value.get_number() == ( x ) &&json_value.get_type() == EJsonType::JSON_NUMBER); \
+        BOOST_CHECK(json_value.get_number() == ( x ) &&json_value.is_number()); \
+    } while( 0 )
+
+#define TEST_INTEGER(x, type, getter, str ) \
+    do{\
+        JsonParse jp; \
+        auto [json_value, json_err] = jp.parse(str); \
+        BOOST_CHECK(json_err == JParseError::JSON_PARSE_OK); \
+        BOOST_CHECK(json_value.get_type() == type && json_value.getter() == ( x )); \
     } while( 0 )
 
 #define TEST_STRING(res_str, str  ) \
@@ -56,6 +73,39 @@ static void test_invalid_value() {
   BOOST_CHECK( jp.parse( "  a", 3 ).second == JParseError::JSON_PARSE_INVALID_VALUE); // should error
   BOOST_CHECK( jp.parse( "a a", 3 ).second == JParseError::JSON_PARSE_INVALID_VALUE); // should error
   BOOST_CHECK( jp.parse( "a ", 2 ).second == JParseError::JSON_PARSE_INVALID_VALUE); // should error
+
+  // 字面量被view截断时，不能读到view后面的字节
+  const char buf[] = "[null, true, false]";
+  BOOST_CHECK(JsonParse::parse(std::string_view(buf, 4)).second == JSON_PARSE_ARRAY_MISS_VALUE);
+  BOOST_CHECK(JsonParse::parse(std::string_view(buf + 1, 3)).second == JSON_PARSE_INVALID_VALUE);
+  BOOST_CHECK(JsonParse::parse(std::string_view(buf + 7, 3)).second == JSON_PARSE_INVALID_VALUE);
+  BOOST_CHECK(JsonParse::parse(std::string_view(buf + 13, 4)).second == JSON_PARSE_INVALID_VALUE);
+  BOOST_CHECK(JsonParse::parse(std::string_view(buf + 1, 4)).second == JSON_PARSE_OK);
+  JsonTape tape;
+  BOOST_CHECK(JsonParse::parse(std::string_view(buf, 4), tape) == JSON_PARSE_ARRAY_MISS_VALUE);
+}
+static void test_whitespace()
+{
+  // 只有 ' ' '\t' '\n' '\r' 是空白，'\v'和'\f'不是
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NULL, " \t\r\n null \t\r\n");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "\vnull");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "\fnull");
+  TEST_PARSE_ERROR(JSON_PARSE_ROOT_NOT_SINGULAR, "null\v");
+  TEST_PARSE_ERROR(JSON_PARSE_ARRAY_MISS_VALUE, "[\f1]");
+
+  // 各种长度的缩进，空白的结尾落在SIMD块的不同位置
+  const char ws[] = " \t\r\n";
+  for (size_t n = 0; n < 80; n++) {
+    string pad;
+    for (size_t i = 0; i < n; i++) pad += ws[i % 4];
+    string str = pad + "{" + pad + "\"a\"" + pad + ":" + pad + "[" + pad + "1" + pad + "," + pad +
+                 "2" + pad + "]" + pad + "}" + pad;
+    auto [value, err] = JsonParse::parse(str);
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    BOOST_CHECK(value.get_object_element_by("a")[1].get_int64() == 2);
+    BOOST_CHECK(JsonParse::parse(pad + "1" + pad + "\v").second == JSON_PARSE_ROOT_NOT_SINGULAR);
+    BOOST_CHECK(JsonParse::parse(pad).second == JSON_PARSE_EXPECT_VALUE);
+  }
 }
 
 
@@ -80,9 +130,63 @@ static void test_parse_number() {
   TEST_NUMBER( 1.234E+10, "1.234E+10" );
   TEST_NUMBER( 1.234E-10, "1.234E-10" );
   TEST_NUMBER( 0.0, "1e-10000" ); /* must underflow */
+  TEST_NUMBER( 0.1, "0.1" );
+  TEST_NUMBER( 1.0000000000000002, "1.0000000000000002" ); /* the smallest number > 1 */
+  TEST_NUMBER( 4.9406564584124654e-324, "4.9406564584124654e-324" ); /* minimum denormal */
+  TEST_NUMBER( -4.9406564584124654e-324, "-4.9406564584124654e-324" );
+  TEST_NUMBER( 2.2250738585072009e-308, "2.2250738585072009e-308" );  /* Max subnormal double */
+  TEST_NUMBER( -2.2250738585072009e-308, "-2.2250738585072009e-308" );
+  TEST_NUMBER( 2.2250738585072014e-308, "2.2250738585072014e-308" );  /* Min normal positive double */
+  TEST_NUMBER( -2.2250738585072014e-308, "-2.2250738585072014e-308" );
+  TEST_NUMBER( 1.7976931348623157e+308, "1.7976931348623157e+308" );  /* Max double */
+  TEST_NUMBER( -1.7976931348623157e+308, "-1.7976931348623157e+308" );
+  TEST_NUMBER( 9007199254740993.0, "9007199254740993" ); /* 2^53 + 1, ties to even */
+  TEST_NUMBER( HUGE_VAL, "1e400" );
+  // 超过19位有效数字，和strtod逐位比较
+  const char *long_numbers[] = {
+      "2.2250738585072011e-308",
+      "0.1000000000000000055511151231257827021181583404541015625",
+      "7.3177701707893310e+15",
+      "123456789012345678901234567890",
+      "9007199254740992.99999999999999999999",
+      "-65.613616999999977037788683082908391952514648437500",
+      "0.00000000000000000000000000000000000000000000000001",
+  };
+  for (auto str : long_numbers) {
+    TEST_NUMBER( strtod(str, nullptr), str );
+  }
 }
 
 
+static void test_parse_integer() {
+  TEST_INTEGER( 0, EJsonType::JSON_INT64, get_int64, "0" );
+  TEST_INTEGER( -1, EJsonType::JSON_INT64, get_int64, "-1" );
+  TEST_INTEGER( 1597046400123456789, EJsonType::JSON_INT64, get_int64, "1597046400123456789" );
+  TEST_INTEGER( INT64_MAX, EJsonType::JSON_INT64, get_int64, "9223372036854775807" );
+  TEST_INTEGER( INT64_MIN, EJsonType::JSON_INT64, get_int64, "-9223372036854775808" );
+  TEST_INTEGER( 123u, EJsonType::JSON_INT64, get_uint64, "123" );
+  TEST_INTEGER( 9223372036854775808u, EJsonType::JSON_UINT64, get_uint64, "9223372036854775808" );
+  TEST_INTEGER( UINT64_MAX, EJsonType::JSON_UINT64, get_uint64, "18446744073709551615" );
+  // 超出范围、-0以及带小数或指数的都是double
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NUMBER, "18446744073709551616");
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NUMBER, "-9223372036854775809");
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NUMBER, "123456789012345678901234567890");
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NUMBER, "-0");
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NUMBER, "1.0");
+  TEST_CHECK(JSON_PARSE_OK, EJsonType::JSON_NUMBER, "1e2");
+  TEST_NUMBER( 18446744073709551616.0, "18446744073709551616" );
+  TEST_NUMBER( 9007199254740993.0, "9007199254740993" );
+
+  JsonTape tape;
+  BOOST_CHECK(JsonParse::parse("[9007199254740993, -1, 18446744073709551615, 0.5]", tape) == JSON_PARSE_OK);
+  auto root = tape.root();
+  BOOST_CHECK(root[0].get_type() == EJsonType::JSON_INT64 && root[0].get_int64() == 9007199254740993);
+  BOOST_CHECK(root[1].get_int64() == -1 && root[1].get_number() == -1.0);
+  BOOST_CHECK(root[2].get_type() == EJsonType::JSON_UINT64 && root[2].get_uint64() == UINT64_MAX);
+  BOOST_CHECK(root[3].get_type() == EJsonType::JSON_NUMBER && root[3].get_number() == 0.5);
+  BOOST_CHECK(root.size() == 4);
+}
+
 static void test_parse_invalid_number() {
   /* ... */
   /* invalid number */
@@ -95,12 +199,63 @@ static void test_parse_invalid_number() {
   TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "inf" );
   TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "NAN" );
   TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "nan" );
+  // 整数、小数和指数部分各只有一个，0后面不能再跟数字
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1.5.3" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "0.1.2" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1e5e3" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1e5.3" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1.5e3.1" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1e+5-3" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "01" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "-01" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "00" );
+  TEST_PARSE_ERROR(JSON_PARSE_ARRAY_MISS_VALUE, "[1, 1.5.3]" );
+  TEST_PARSE_ERROR(JSON_PARSE_OBJECT_MISS_MEMBER, "{\"a\": 01}" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1e" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "1e-" );
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_VALUE, "-" );
 }
 static void test_parse_string(){
   TEST_STRING("", "\"\"");
   TEST_STRING("Hello", "\"Hello\"");
   TEST_STRING("Hello\nWorld", "\"Hello\\nWorld\"");
   TEST_STRING("\" \\ / \b \f \n \r \t", "\"\\\" \\\\ \\/ \\b \\f \\n \\r \\t\"");
+  // 超过一个SIMD块的字符串，转义落在块的不同位置
+  string text(100, 'a');
+  for (size_t i = 0; i < 40; i++) {
+    string str = "\"" + text.substr(0, i) + "\\n" + text + "\\\"" + text.substr(0, i) + "\"";
+    TEST_STRING(text.substr(0, i) + "\n" + text + "\"" + text.substr(0, i), str.c_str());
+  }
+  TEST_STRING("\xE4\xBD\xA0\xE5\xA5\xBD", "\"\xE4\xBD\xA0\xE5\xA5\xBD\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_STRING_CHAR, ("\"" + text + "\x01\"").c_str());
+  TEST_PARSE_ERROR(JSON_PARSE_STRING_MISS_DOUBLE_QUATION, ("\"" + text).c_str());
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_STRING_ESCAPE, ("\"" + text + "\\x\"").c_str());
+  // \\u转义，包括代理对和小写十六进制
+  TEST_STRING("\x24", "\"\\u0024\"");
+  TEST_STRING("\xC2\xA2", "\"\\u00A2\"");
+  TEST_STRING("\xE2\x82\xAC", "\"\\u20AC\"");
+  TEST_STRING("\xF0\x9D\x84\x9E", "\"\\uD834\\uDD1E\"");
+  TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\"");
+  TEST_STRING("a\xE4\xBD\xA0" "b\n", "\"a\\u4f60b\\n\"");
+  TEST_STRING(string("\0", 1), "\"\\u0000\"");
+  TEST_STRING(text + "\xE2\x82\xAC" + text, ("\"" + text + "\\u20AC" + text + "\"").c_str());
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u0\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u01\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u012\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u/000\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\uG000\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u0G00\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u00G0\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u000/\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\u 123\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_HEX, "\"\\uD800\\u12\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDBFF\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\\\\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uDBFF\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
+  TEST_PARSE_ERROR(JSON_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDC00\"");
 }
 static void test_parse_object(){
   JsonParse jp;
@@ -137,6 +292,61 @@ static void test_parse_object(){
   jp.parse(str2);
 
 
+}
+static void test_object_members()
+{
+  // 成员保持原文的顺序，重复的key都保留，查找时取最后一个
+  auto [value, err] = JsonParse::parse("{\"b\": 1, \"a\": 2, \"a\\\"x\": 3, \"b\": 4}");
+  BOOST_CHECK(err == JSON_PARSE_OK);
+  BOOST_CHECK(value.get_object_size() == 4);
+  const char *keys[] = {"b", "a", "a\"x", "b"};
+  for (size_t i = 0; i < 4; i++) {
+    BOOST_CHECK(value.get_object_member(i).key() == keys[i]);
+    BOOST_CHECK(value.get_object_member(i).value.get_int64() == int64_t(i + 1));
+  }
+  BOOST_CHECK(value.get_object_element_by("b").get_int64() == 4);
+  BOOST_CHECK(value.get_object_element_by("a\"x").get_int64() == 3);
+  BOOST_CHECK(JsonParse::parse("{}").first.get_object_size() == 0);
+
+  // 成员多时用hash索引，结果和顺序查找一样
+  for (int n : {16, 17, 1000}) {
+    string json = "{";
+    for (int i = 0; i < n; i++)
+      json += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ",";
+    json += "\"key0\": -1}";
+    JsonDocument doc;
+    BOOST_CHECK(JsonParse::parse(json, doc) == JSON_PARSE_OK);
+    BOOST_CHECK(doc.root().get_object_size() == size_t(n + 1));
+    BOOST_CHECK(doc.root().get_object_element_by("key0").get_int64() == -1);
+    for (int i = 1; i < n; i++) {
+      BOOST_CHECK(doc.root().get_object_element_by("key" + std::to_string(i)).get_int64() == i);
+    }
+    auto [tree, tree_err] = JsonParse::parse(json);
+    BOOST_CHECK(tree.get_object_element_by("key" + std::to_string(n - 1)).get_int64() == n - 1);
+  }
+}
+static void test_object_lookup()
+{
+  // string_view和预先算好hash的JsonKey，小对象和带索引的大对象都要覆盖
+  for (int n : {3, 100}) {
+    string json = "{";
+    for (int i = 0; i < n; i++)
+      json += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ",";
+    json += "\"user_id\": 42, \"nested\": {\"user_id\": 7}}";
+    auto [value, err] = JsonParse::parse(json);
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    static const JsonKey kUserId("user_id");
+    std::string_view name = "user_id";
+    BOOST_CHECK(value[kUserId].get_int64() == 42);
+    BOOST_CHECK(value[name].get_int64() == 42);
+    BOOST_CHECK(value["nested"][kUserId].get_int64() == 7);
+    BOOST_CHECK(value.get_object_element_by(JsonKey("key2")).get_int64() == 2);
+
+    BOOST_CHECK(value.find(kUserId) == &value[name]);
+    BOOST_CHECK(value.find("missing") == nullptr);
+    BOOST_CHECK(value.find(JsonKey("missing")) == nullptr);
+    BOOST_CHECK(value[kUserId].find("user_id") == nullptr);
+  }
 }
 static void test_parse_object_miss_key()
 {
@@ -220,30 +430,774 @@ static void test_array_error()
   TEST_PARSE_ERROR(JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET, "[123, null") ;
   TEST_PARSE_ERROR(JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA, "[123, false,]") ;
 }
+static void test_parse_document()
+{
+  JsonDocument doc;
+  BOOST_CHECK(JsonParse::parse("[null, [1, \"abc\"], {\"k\" : true}]", doc) == JSON_PARSE_OK);
+  auto &root = doc.root();
+  BOOST_CHECK(root.get_type() == EJsonType::JSON_ARRAY);
+  BOOST_CHECK(root[0].get_null() == nullptr);
+  BOOST_CHECK(root[1][0].get_number() == 1);
+  BOOST_CHECK(root[1][1].get_string() == "abc");
+  BOOST_CHECK(root[2].get_object_element_by("k").get_boolean() == true);
+  BOOST_CHECK(doc.arena().bytes_used() > 0);
+
+  // doc可以反复使用，失败的解析不影响下一次
+  BOOST_CHECK(JsonParse::parse("[1, 2", doc) == JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET);
+  BOOST_CHECK(JsonParse::parse("\"x\"", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root().get_string() == "x");
+}
+static void test_parse_insitu()
+{
+  char buf[] = "[\"abc\", \"a\\nb\\\"c\", {\"k\\t\" : \"v\"}, 1]";
+  auto [json_value, json_err] = JsonParse::parse_insitu(buf, strlen(buf));
+  BOOST_CHECK(json_err == JSON_PARSE_OK);
+  BOOST_CHECK(json_value[0].get_string_view() == "abc");
+  BOOST_CHECK(json_value[0].get_string_view().data() == buf + 2);
+  BOOST_CHECK(json_value[1].get_string() == "a\nb\"c");
+  BOOST_CHECK(json_value[1].get_string_view().data() == buf + 9);
+  BOOST_CHECK(json_value[2].get_object_element_by("k\t").get_string_view() == "v");
+  BOOST_CHECK(json_value[3].get_number() == 1);
+
+  string text(100, 'x');
+  string str = "{\"s\" : \"" + text + "\\u\"}";
+  JsonDocument doc;
+  BOOST_CHECK(JsonParse::parse_insitu(&str[0], str.size(), doc) == JSON_PARSE_OBJECT_MISS_MEMBER);
+  str = "[\"" + text + "\\r\\n" + text + "\"]";
+  BOOST_CHECK(JsonParse::parse_insitu(&str[0], str.size(), doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()[0].get_string() == text + "\r\n" + text);
+  // 非原地解析的结果不受影响
+  BOOST_CHECK(JsonParse::parse("[\"abc\"]").first[0].get_string_view() == "abc");
+}
+static void test_parse_borrowed()
+{
+  string str = "{\"plain\" : \"abc\", \"esc\\n\" : [\"a\\\"b\", \"\"]}";
+  JsonDocument doc;
+  BOOST_CHECK(JsonParse::parse_borrowed(str, doc) == JSON_PARSE_OK);
+  auto &root = doc.root();
+  auto plain = root.get_object_element_by("plain").get_string_view();
+  BOOST_CHECK(plain == "abc");
+  // 没有转义的指向输入，有转义的解码到自己的存储
+  BOOST_CHECK(plain.data() == str.data() + str.find("abc"));
+  auto &array = root.get_object_element_by("esc\n");
+  BOOST_CHECK(array[0].get_string() == "a\"b");
+  BOOST_CHECK(array[0].get_string_view().data() < str.data() ||
+              array[0].get_string_view().data() >= str.data() + str.size());
+  BOOST_CHECK(array[1].get_string_view().empty());
+
+  auto [json_value, json_err] = JsonParse::parse_borrowed("[\"x\", 1, \"y");
+  BOOST_CHECK(json_err == JSON_PARSE_ARRAY_MISS_VALUE);
+  BOOST_CHECK(JsonParse::parse_borrowed("{\"k\" 1}", doc) == JSON_PARSE_OBJECT_MISS_COLON);
+}
+static void test_parse_tape()
+{
+  JsonTape tape;
+  string str = " { "
+               "\"n\" : null , "
+               "\"f\" : false , "
+               "\"t\" : true , "
+               "\"i\" : 123 , "
+               "\"s\" : \"abc\", "
+               "\"a\" : [ 1, 2, 3 ],"
+               "\"o\" : { \"1\" : 1, \"2\" : [], \"3\" : {} }"
+               " } ";
+  BOOST_CHECK(JsonParse::parse(str, tape) == JSON_PARSE_OK);
+  auto root = tape.root();
+  BOOST_CHECK(root.get_type() == EJsonType::JSON_OBJECT);
+  BOOST_CHECK(root.size() == 7);
+  BOOST_CHECK(root.get_object_element_by("n").get_null() == nullptr);
+  BOOST_CHECK(root.get_object_element_by("f").get_boolean() == false);
+  BOOST_CHECK(root.get_object_element_by("t").get_boolean() == true);
+  BOOST_CHECK(root.get_object_element_by("i").get_number() == 123);
+  BOOST_CHECK(root.get_object_element_by("s").get_string() == "abc");
+  auto array = root.get_object_element_by("a");
+  BOOST_CHECK(array.size() == 3);
+  BOOST_CHECK(array[0].get_number() == 1 && array[2].get_number() == 3);
+  double sum = 0;
+  for (auto elem : array) sum += elem.get_number();
+  BOOST_CHECK(sum == 6);
+  auto object = root.get_object_element_by("o");
+  BOOST_CHECK(object.get_object_element_by("1").get_number() == 1);
+  BOOST_CHECK(object.get_object_element_by("2").size() == 0);
+  BOOST_CHECK(object.get_object_element_by("3").get_type() == EJsonType::JSON_OBJECT);
+
+  // 错误码和DOM一致
+  BOOST_CHECK(JsonParse::parse("[123, false,]", tape) == JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA);
+  BOOST_CHECK(JsonParse::parse("{\"a\":true \"", tape) == JSON_PARSE_OBJECT_MISS_COMMA);
+  BOOST_CHECK(JsonParse::parse("{\"a\"} abc,", tape) == JSON_PARSE_OBJECT_MISS_COLON);
+  BOOST_CHECK(JsonParse::parse("null x", tape) == JSON_PARSE_ROOT_NOT_SINGULAR);
+
+  // 重复的key和DOM一样取最后一个
+  string dup = "{\"a\": 1, \"b\": [2], \"a\": {\"c\": 3}, \"b\": 4}";
+  BOOST_CHECK(JsonParse::parse(dup, tape) == JSON_PARSE_OK);
+  auto [dom, dom_err] = JsonParse::parse(dup);
+  BOOST_CHECK(tape.root().size() == 4 && dom.get_object_size() == 4);
+  BOOST_CHECK(tape.root().get_object_element_by("a")
+                  .get_object_element_by("c").get_int64() == 3);
+  BOOST_CHECK(dom["a"]["c"].get_int64() == 3);
+  BOOST_CHECK(tape.root().get_object_element_by("b").get_int64() == 4);
+  BOOST_CHECK(dom["b"].get_int64() == 4);
+
+  // 超过32位能表示的输入在读之前就被拒绝，这里的长度是假的
+  std::string_view huge(str.data(), JsonTape::kMaxDocumentSize + 1);
+  BOOST_CHECK(JsonParse::parse(huge, tape) == JSON_PARSE_DOCUMENT_TOO_LARGE);
+  BOOST_CHECK(tape.size() == 0);
+}
+static void test_parse_on_demand()
+{
+  JsonOnDemand doc;
+  string str = " { "
+               "\"skip\" : [ {\"a\" : \"}]\\\"\"}, [[]], \"x\" ], "
+               "\"user\" : { \"name\" : \"Pawn\\n\", \"id\" : 9007199254740993 }, "
+               "\"esc\\u0041pe\" : null, "
+               "\"k\\\"ey\" : true, "
+               "\"list\" : [ 1.5, false, \"s\" ] "
+               " } ";
+  BOOST_CHECK(JsonParse::parse(str, doc) == JSON_PARSE_OK);
+  auto root = doc.root();
+  BOOST_CHECK(root.get_type() == EJsonType::JSON_OBJECT);
+  BOOST_CHECK(root["user"]["id"].get_int64() == 9007199254740993);
+  BOOST_CHECK(root["user"]["id"].get_type() == EJsonType::JSON_INT64);
+  BOOST_CHECK(root["user"]["name"].get_string() == "Pawn\n");
+  BOOST_CHECK(root["k\"ey"].get_boolean() == true);
+  BOOST_CHECK(root["list"][0].get_number() == 1.5);
+  BOOST_CHECK(root["list"][1].get_boolean() == false);
+  BOOST_CHECK(root["list"][2].get_string() == "s");
+  BOOST_CHECK(root["skip"][2].get_string() == "x");
+  int count = 0;
+  for (auto elem : root["list"]) count += elem.error() == JSON_PARSE_OK;
+  BOOST_CHECK(count == 3);
+
+  // 查找失败和语法错误
+  BOOST_CHECK(root["nope"].error() == JSON_PARSE_OBJECT_KEY_NOT_EXIST);
+  BOOST_CHECK(root["nope"]["id"].error() == JSON_PARSE_OBJECT_KEY_NOT_EXIST);
+  BOOST_CHECK(root["list"][3].error() == JSON_PARSE_ARRAY_INDEX_OUT_OF_RANGE);
+  BOOST_CHECK(JsonParse::parse(" ", doc) == JSON_PARSE_EXPECT_VALUE);
+  BOOST_CHECK(JsonParse::parse("{\"a\" 1}", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()["a"].error() == JSON_PARSE_OBJECT_MISS_COLON);
+  BOOST_CHECK(JsonParse::parse("{\"a\":1 \"b\":2}", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()["b"].error() == JSON_PARSE_OBJECT_MISS_COMMA);
+  BOOST_CHECK(JsonParse::parse("[1, [2, 3], 4", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()[2].get_number() == 4);
+  BOOST_CHECK(doc.root()[3].error() == JSON_PARSE_ARRAY_MISS_RIGHT_BRACKET);
+  BOOST_CHECK(JsonParse::parse("[1, 2,]", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()[2].error() == JSON_PARSE_ARRAY_LAST_MUST_NOT_COMMA);
+
+  // 带转义的key按解码后的内容比较，原文长度相同也不能直接比较
+  const char *escaped = "{\"a\\\"b\":1, \"c\\\\d\":2, \"\\u0065\":3, \"x\\/\":4}";
+  BOOST_CHECK(JsonParse::parse(escaped, doc) == JSON_PARSE_OK);
+  auto [dom, dom_err] = JsonParse::parse(escaped);
+  BOOST_CHECK(dom_err == JSON_PARSE_OK);
+  const char *keys[] = {"a\"b", "a\\\"b", "c\\d", "c\\\\d", "e", "\\u0065", "x/", "x\\/"};
+  for (const char *key : keys) {
+    JsonType *member = dom.find(key);
+    auto cursor = doc.root()[key];
+    BOOST_CHECK((member != nullptr) == (cursor.error() == JSON_PARSE_OK));
+    if (member != nullptr) BOOST_CHECK(cursor.get_int64() == member->get_int64());
+  }
+  BOOST_CHECK(doc.root()["a\\\"b"].error() == JSON_PARSE_OBJECT_KEY_NOT_EXIST);
+  BOOST_CHECK(doc.root()["e"].get_int64() == 3);
+
+  // 重复的key和DOM、tape一样取最后一个，找到之后的语法错误也要报出来
+  const char *dup = "{\"a\": 1, \"b\": [2], \"a\": {\"c\": 3}, \"b\": 4}";
+  BOOST_CHECK(JsonParse::parse(dup, doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()["a"]["c"].get_int64() == 3);
+  BOOST_CHECK(doc.root()["b"].get_int64() == 4);
+  BOOST_CHECK(JsonParse::parse("{\"a\": 1, \"a\": 2", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()["a"].error() == JSON_PARSE_OBJECT_MISS_RIGHT_BRACKET);
+  BOOST_CHECK(JsonParse::parse("{\"a\": 1 \"b\": 2}", doc) == JSON_PARSE_OK);
+  BOOST_CHECK(doc.root()["a"].error() == JSON_PARSE_OBJECT_MISS_COMMA);
+}
+// 把事件重新拼成文本，数字只看类型
+class EchoHandler : public JsonBaseHandler<EchoHandler> {
+ public:
+  bool null() { return emit("n"); }
+  bool boolean(bool b) { return emit(b ? "t" : "f"); }
+  bool number(double) { return emit("d"); }
+  bool int64(int64_t i) { return emit("i" + std::to_string(i)); }
+  bool string(std::string_view str) { return emit("\"" + std::string(str) + "\""); }
+  bool start_object() { return emit("{"); }
+  bool key(std::string_view str) { return emit(std::string(str) + ":"); }
+  bool end_object(size_t n) { return emit("}" + std::to_string(n)); }
+  bool start_array() { return emit("["); }
+  bool end_array(size_t n) { return emit("]" + std::to_string(n)); }
+
+  std::string out;
+  size_t limit = SIZE_MAX;
+
+ private:
+  bool emit(const std::string &event) {
+    out += event;
+    out += ' ';
+    return --limit != 0;
+  }
+};
+static void test_parse_handler()
+{
+  EchoHandler handler;
+  BOOST_CHECK(JsonParse::parse(" { \"a\" : [ null, true, false, -1, 1.5, 18446744073709551615 ], "
+                               "\"b\\\"c\" : { }, \"d\" : \"e\\nf\" } ",
+                               handler) == JSON_PARSE_OK);
+  BOOST_CHECK(handler.out == "{ a: [ n t f i-1 d d ]6 b\"c: { }0 d: \"e\nf\" }3 ");
+
+  // 错误码和DOM一致
+  const char *bad[] = {"", "[1 2]", "[1,]", "{\"a\" 1}", "{1:2}", "{\"a\":}", "[1] x", "[\"\\x\"]"};
+  for (const char *str : bad) {
+    EchoHandler h;
+    BOOST_CHECK(JsonParse::parse(str, h) == JsonParse::parse(str).second);
+  }
+
+  // handler返回false时立即停止
+  handler.out.clear();
+  handler.limit = 3;
+  BOOST_CHECK(JsonParse::parse("[[1, 2], 3]", handler) == JSON_PARSE_TERMINATED);
+  BOOST_CHECK(handler.out == "[ [ i1 ");
+  handler.out.clear();
+  handler.limit = 2;
+  BOOST_CHECK(JsonParse::parse("{\"k\": 1}", handler) == JSON_PARSE_TERMINATED);
+  BOOST_CHECK(handler.out == "{ k: ");
+}
+static void test_parse_stream()
+{
+  // 在每个位置切成两块，以及逐字节输入，事件和错误码都要与整块解析一致
+  const char *docs[] = {
+      " { \"a\" : [ null, true, false, -1, 1.5e3, 18446744073709551615 ], "
+      "\"b\\\"c\" : { }, \"d\" : \"e\\nf\\\\\", \"g\": [[], [{}]] } ",
+      "123", "\"abc\"", "", " ", "[1 2]", "[1,]", "{\"a\" 1}", "{1:2}", "{\"a\":}",
+      "[1] x", "[\"\\x\"]", "[1.5.3]", "1e5e3", "[-01]", "[tru]", "{\"a\":[1}", "[[1", "{\"a\":{\"b\":", "{\"a\"",
+      "{\"a\":1,}", "[\"abc", "\"a\\", "-", "[01]", "{\"k\\q\":1}", "nul", "1.5x",
+      "[\"\\u0041\\u00e9\\u4F60\\uD834\\uDD1E\"]", "{\"\\u0061\":\"\\ud834\\udd1e\"}",
+      "\"\\u12\"", "\"\\uD800\"", "\"\\uD800\\u0041\"", "\"\\uDC00\"", "\"\\u00",
+      " \t\r\n[\n    1 ,\r\n\t\t{ \"a\" :\n\t2 }\n] \n", "\v1", "[1\f]", "{\"a\":\f1}"};
+  for (const char *str : docs) {
+    size_t n = strlen(str);
+    EchoHandler expected;
+    JParseError err = JsonParse::parse(std::string_view(str, n), expected);
+    for (size_t cut = 0; cut <= n; cut++) {
+      EchoHandler handler;
+      JsonStreamParser<EchoHandler> parser(handler);
+      parser.feed(str, cut);
+      parser.feed(str + cut, n - cut);
+      BOOST_CHECK(parser.finish() == err);
+      BOOST_CHECK(handler.out == expected.out || err != JSON_PARSE_OK);
+    }
+    EchoHandler handler;
+    JsonStreamParser<EchoHandler> parser(handler);
+    for (size_t i = 0; i < n; i++) parser.feed(str + i, 1);
+    BOOST_CHECK(parser.finish() == err);
+    BOOST_CHECK(handler.out == expected.out || err != JSON_PARSE_OK);
+  }
+
+  // 中止之后不再有事件，reset之后可以解析下一个文档
+  EchoHandler handler;
+  handler.limit = 2;
+  JsonStreamParser<EchoHandler> parser(handler);
+  BOOST_CHECK(parser.feed("[1, 2, 3]", 9) == JSON_PARSE_TERMINATED);
+  BOOST_CHECK(parser.finish() == JSON_PARSE_TERMINATED);
+  BOOST_CHECK(handler.out == "[ i1 ");
+  handler.out.clear();
+  handler.limit = SIZE_MAX;
+  parser.reset();
+  BOOST_CHECK(parser.feed("[4]", 3) == JSON_PARSE_OK);
+  BOOST_CHECK(parser.finish() == JSON_PARSE_OK);
+  BOOST_CHECK(handler.out == "[ i4 ]1 ");
+}
+static void test_validate_utf8()
+{
+  // 默认不检查，原样保留
+  BOOST_CHECK(JsonParser().parse("\"\xC0\x80\"").second == JSON_PARSE_OK);
+
+  JsonParser parser;
+  parser.set_validate_utf8(true);
+  const char *valid[] = {"\xE4\xBD\xA0\xE5\xA5\xBD", "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80",
+                         "\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF"};
+  const char *invalid[] = {"\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC2", "\xC2\x41",
+                           "\xE0\x80\x80", "\xE0\x9F\xBF", "\xED\xA0\x80", "\xED\xBF\xBF",
+                           "\xE4\xBD", "\xF0\x80\x80\x80", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+                           "\xFF", "\xF0\x90\x80"};
+  // 多字节字符落在SIMD块的不同位置，前后都有转义和没有转义的情况
+  for (size_t i = 0; i < 40; i++) {
+    string pad(i, 'a');
+    for (const char *ch : valid) {
+      string str = "\"" + pad + ch + "\"";
+      auto [value, err] = parser.parse(str);
+      BOOST_CHECK(err == JSON_PARSE_OK && value.get_string() == pad + ch);
+      str = "[\"\\n" + pad + ch + pad + "\\t\"]";
+      BOOST_CHECK(parser.parse(str).second == JSON_PARSE_OK);
+    }
+    for (const char *ch : invalid) {
+      BOOST_CHECK(parser.parse("\"" + pad + ch + "\"").second == JSON_PARSE_INVALID_UTF8);
+      BOOST_CHECK(parser.parse("\"\\n" + pad + ch + pad + "\"").second == JSON_PARSE_INVALID_UTF8);
+      // key里的错误和其它key错误一样报成缺少key
+      BOOST_CHECK(parser.parse("{\"" + pad + ch + "\":1}").second == JSON_PARSE_OBJECT_MISS_KEY);
+    }
+  }
+  // 前后都是多字节字符，错误的字节落在按块查表时的不同位置，也跨过块的边界
+  for (size_t i = 0; i < 40; i++) {
+    string wide;
+    for (size_t k = 0; k < i; k++) wide += k % 3 ? "\xE4\xBD\xA0" : "\xC3\xA9";
+    for (const char *ch : valid) {
+      BOOST_CHECK(parser.parse("\"" + wide + ch + wide + "\"").second == JSON_PARSE_OK);
+      BOOST_CHECK(parser.parse("\"" + wide + "a" + ch + "\"").second == JSON_PARSE_OK);
+    }
+    for (const char *ch : invalid) {
+      BOOST_CHECK(parser.parse("\"" + wide + ch + wide + "\"").second == JSON_PARSE_INVALID_UTF8);
+      BOOST_CHECK(parser.parse("\"" + wide + ch + "\"").second == JSON_PARSE_INVALID_UTF8);
+    }
+  }
+
+  // \\u转义出来的字节总是合法的，流式解析同样检查
+  BOOST_CHECK(parser.parse("\"\\uD834\\uDD1E\\u00e9\"").second == JSON_PARSE_OK);
+  EchoHandler handler;
+  JsonStreamParser<EchoHandler> stream(handler);
+  stream.set_validate_utf8(true);
+  for (string str : {"\"\xE4\xBD\xA0\"", "[\"\xE4\xBD\xA0\"]", "\"\xED\xA0\x80\"", "[\"\xED\xA0\x80\"]",
+                     "\"\\n\xF4\x90\x80\x80\"", "{\"a\xC0\x80\":1}", "\"\xE4\xBD"}) {
+    JParseError err = parser.parse(str).second;
+    for (size_t cut = 0; cut <= str.size(); cut++) {
+      stream.reset();
+      stream.feed(str.data(), cut);
+      stream.feed(str.data() + cut, str.size() - cut);
+      BOOST_CHECK(stream.finish() == err);
+    }
+  }
+  BOOST_CHECK(parser.parse("\"\xED\xA0\x80\"").second == JSON_PARSE_INVALID_UTF8);
+}
+static void test_parse_many()
+{
+  // 空行跳过，出错的行不影响其它行，\r\n也可以
+  string ndjson;
+  for (int i = 0; i < 2000; i++) {
+    if (i % 7 == 3) ndjson += "{\"id\": " + std::to_string(i) + ", }";
+    else ndjson += "{\"id\": " + std::to_string(i) + ", \"name\": \"user\\n\"}";
+    ndjson += i % 5 == 0 ? "\r\n\n  \n" : "\n";
+  }
+  ndjson += "[1, 2]";
+  for (size_t threads : {1, 4}) {
+    JsonBatch batch;
+    BOOST_CHECK(JsonParse::parse_many(ndjson, batch, threads) == 286);
+    BOOST_CHECK(batch.size() == 2001);
+    for (int i = 0; i < 2000; i++) {
+      auto &record = batch[i];
+      if (i % 7 == 3) {
+        BOOST_CHECK(record.error == JSON_PARSE_OBJECT_LAST_MUST_NOT_COMMA);
+        continue;
+      }
+      BOOST_CHECK(record.error == JSON_PARSE_OK);
+      BOOST_CHECK(record.value.get_object_element_by("id").get_int64() == i);
+      BOOST_CHECK(record.value.get_object_element_by("name").get_string() == "user\n");
+    }
+    BOOST_CHECK(batch[2000].value[1].get_int64() == 2);
+    BOOST_CHECK(batch[2000].json == "[1, 2]");
+  }
+  JsonBatch batch;
+  BOOST_CHECK(JsonParse::parse_many("", batch) == 0);
+  BOOST_CHECK(batch.size() == 0);
+}
+static void test_parse_parallel()
+{
+  string json = "[";
+  for (int i = 0; i < 500; i++) {
+    if (i != 0) json += i % 3 ? "," : " ,\n  ";
+    json += "{\"id\": " + std::to_string(i) + ", \"tags\": [\"a,b\", \"]\"], \"v\": " +
+            (i % 2 ? "null" : "[[1], {}]") + "}";
+  }
+  json += " ] ";
+  for (size_t threads : {1, 3, 8}) {
+    JsonDocument doc;
+    BOOST_CHECK(JsonParse::parse_parallel(json, doc, threads) == JSON_PARSE_OK);
+    for (int i = 0; i < 500; i++) {
+      auto &elem = doc.root()[i];
+      BOOST_CHECK(elem.get_object_element_by("id").get_int64() == i);
+      BOOST_CHECK(elem.get_object_element_by("tags")[1].get_string() == "]");
+    }
+  }
+
+  // 不是数组、元素太少或者出错时结果和串行解析一样
+  const char *others[] = {"{\"a\": 1}", "[]", "[1]", "[1, 2,]", "[1, 2", "[1, 2] 3",
+                          "[1, [2 3], 4]", "[1, , 2]", "[\"abc, 1]"};
+  for (const char *str : others) {
+    JsonDocument doc;
+    BOOST_CHECK(JsonParse::parse_parallel(str, doc, 4) == JsonParse::parse(str).second);
+  }
+}
+static void test_json_parser()
+{
+  // 同一个parser反复使用，出错不影响下一次
+  JsonParser parser;
+  for (int i = 0; i < 3; i++) {
+    auto [value, err] = parser.parse("{\"a\": [1, \"x\\ny\"], \"b\": {\"c\": null}}");
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    BOOST_CHECK(value.get_object_element_by("a")[1].get_string() == "x\ny");
+    BOOST_CHECK(parser.parse("[1, {\"a\": 2").second == JSON_PARSE_ARRAY_MISS_VALUE);
+  }
+
+  // use_arena时树在parser的arena里，下一次parse之前有效
+  JsonParser arena_parser(true);
+  for (int i = 0; i < 3; i++) {
+    auto [value, err] = arena_parser.parse("[\"abc\", [true]]");
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    BOOST_CHECK(value[0].get_string() == "abc");
+    BOOST_CHECK(value[1][0].get_boolean() == true);
+  }
+  // 上一次的树在arena回收之后析构，不会再去碰arena里的块(用SIMPLE_JSON_SANITIZE编译时检查)
+  {
+    auto first = arena_parser.parse("{\"a\": [1, \"a long string in a block\"]}");
+    auto second = arena_parser.parse("[[\"another long string\"], {\"b\": null}]");
+    BOOST_CHECK(first.second == JSON_PARSE_OK && second.second == JSON_PARSE_OK);
+    BOOST_CHECK(second.first[1].find("b") != nullptr);
+    auto text = arena_parser.parse("\"a root string longer than 13 bytes\"");
+    BOOST_CHECK(text.first.get_string_view() == "a root string longer than 13 bytes");
+  }
+  // parser先析构
+  {
+    std::pair<JsonType, JParseError> orphan;
+    {
+      JsonParser parser_gone(true);
+      orphan = parser_gone.parse("[[1], [2]]");
+    }
+    BOOST_CHECK(orphan.second == JSON_PARSE_OK);
+  }
+
+  // 反复解析到同一个doc，arena的内存留着复用
+  JsonDocument doc;
+  string json = "[";
+  for (int i = 0; i < 1000; i++) json += std::to_string(i) + ",";
+  json += "0]";
+  BOOST_CHECK(parser.parse(json, doc) == JSON_PARSE_OK);
+  size_t reserved = doc.arena().bytes_reserved();
+  for (int i = 0; i < 3; i++) {
+    BOOST_CHECK(parser.parse(json, doc) == JSON_PARSE_OK);
+    BOOST_CHECK(doc.root()[999].get_int64() == 999);
+    BOOST_CHECK(doc.arena().bytes_reserved() <= reserved);
+  }
+
+  // reset留下的是最大的一块，不是最后申请的那块
+  JsonArena arena(1024);
+  BOOST_CHECK(arena.allocate(1 << 20) != nullptr);
+  BOOST_CHECK(arena.allocate(64 * 1024) != nullptr);
+  arena.reset();
+  size_t kept = arena.bytes_reserved();
+  BOOST_CHECK(kept > (1 << 20) && arena.bytes_used() == 0);
+  BOOST_CHECK(arena.allocate(1 << 20) != nullptr);
+  BOOST_CHECK(arena.bytes_reserved() == kept);
+}
+static void test_max_depth()
+{
+  // 嵌套的层数只受max_depth限制，不会压爆栈
+  const size_t depth = 100000;
+  string deep = string(depth, '[') + string(depth, ']');
+  JsonParser parser;
+  parser.set_max_depth(depth);
+  EchoHandler handler;
+  BOOST_CHECK(parser.parse(deep, handler) == JSON_PARSE_OK);
+  BOOST_CHECK(handler.out.substr(handler.out.size() - 3) == "]1 ");
+  JsonStreamParser<EchoHandler> stream(handler);
+  stream.set_max_depth(depth);
+  BOOST_CHECK(stream.feed(deep.data(), deep.size()) == JSON_PARSE_OK);
+  BOOST_CHECK(stream.finish() == JSON_PARSE_OK);
+
+  // 不在arena里的树析构时也不递归
+  {
+    const size_t huge = 1000000;
+    string arrays = string(huge, '[') + string(huge, ']');
+    string objects;
+    for (size_t i = 0; i < huge / 10; i++) objects += "{\"a long key!!!\": [\"a long string value\", ";
+    objects += "null";
+    for (size_t i = 0; i < huge / 10; i++) objects += "]}";
+    JsonParser unlimited;
+    unlimited.set_max_depth(SIZE_MAX);
+    auto deep_arrays = unlimited.parse(arrays);
+    BOOST_CHECK(deep_arrays.second == JSON_PARSE_OK);
+    auto deep_objects = unlimited.parse(objects);
+    BOOST_CHECK(deep_objects.second == JSON_PARSE_OK);
+    JsonType moved = std::move(deep_objects.first);
+    moved = std::move(deep_arrays.first);
+  }
+
+  // 超过时报错，错误码不会被外层容器改写
+  parser.set_max_depth(3);
+  BOOST_CHECK(parser.parse("[{\"a\": [1]}]").second == JSON_PARSE_OK);
+  BOOST_CHECK(parser.parse("[{\"a\": [[1]]}]").second == JSON_PARSE_DEPTH_EXCEEDED);
+  BOOST_CHECK(parser.parse("{\"a\": [[], {}]}").second == JSON_PARSE_OK);
+  EchoHandler h;
+  JsonStreamParser<EchoHandler> limited(h);
+  limited.set_max_depth(3);
+  BOOST_CHECK(limited.feed("[[[[", 4) == JSON_PARSE_DEPTH_EXCEEDED);
+  BOOST_CHECK(JsonParse::parse(deep).second == JSON_PARSE_DEPTH_EXCEEDED);
+
+  // 默认的max_depth够用，也会带到parse_many和parse_parallel的工作线程
+  string nested = string(JsonParser::kDefaultMaxDepth, '[') +
+                  string(JsonParser::kDefaultMaxDepth, ']');
+  BOOST_CHECK(JsonParse::parse(nested).second == JSON_PARSE_OK);
+  JsonParse::set_max_depth(2);
+  JsonBatch batch;
+  BOOST_CHECK(JsonParse::parse_many("[1]\n[[1]]\n[[[1]]]\n", batch, 2) == 1);
+  BOOST_CHECK(batch[2].error == JSON_PARSE_DEPTH_EXCEEDED);
+  JsonDocument doc;
+  BOOST_CHECK(JsonParse::parse_parallel("[[1], [2], [[3]]]", doc, 2) ==
+              JSON_PARSE_DEPTH_EXCEEDED);
+  BOOST_CHECK(JsonParse::parse_parallel("[[1], [2], [3]]", doc, 2) == JSON_PARSE_OK);
+  JsonParse::set_max_depth(JsonParser::kDefaultMaxDepth);
+}
+static void test_key_pool()
+{
+  // 不同文档里相同的key指向池里的同一份
+  JsonKeyPool pool;
+  JsonParser parser;
+  parser.set_key_pool(&pool);
+  JsonDocument doc1, doc2;
+  BOOST_CHECK(parser.parse("{\"id\": 1, \"name\": \"a\", \"tags\": {\"id\": 2}}", doc1) == JSON_PARSE_OK);
+  BOOST_CHECK(parser.parse("{\"name\": \"b\", \"id\": 3}", doc2) == JSON_PARSE_OK);
+  BOOST_CHECK(pool.size() == 3);
+  BOOST_CHECK(pool.intern("id").data() == pool.intern(string("id")).data());
+  BOOST_CHECK(doc1.root().get_object_element_by("tags").get_object_element_by("id").get_int64() == 2);
+  BOOST_CHECK(doc2.root().get_object_element_by("id").get_int64() == 3);
+  BOOST_CHECK(doc2.root().get_object_element_by("name").get_string() == "b");
+  // 从池里取的key查找时只比地址，不是池里的key仍然比内容
+  std::string_view pooled_id = pool.intern("id");
+  BOOST_CHECK(doc2.root().find(pooled_id) != nullptr &&
+              doc2.root().find(pooled_id)->get_int64() == 3);
+  BOOST_CHECK(doc2.root().find(string("id"))->get_int64() == 3);
+  BOOST_CHECK(doc2.root().find(string("ie")) == nullptr);
+  // 借用输入时key也放进池里
+  auto [value, err] = parser.parse_borrowed("{\"name\": 4}");
+  BOOST_CHECK(err == JSON_PARSE_OK && value.get_object_element_by("name").get_int64() == 4);
+  BOOST_CHECK(pool.size() == 3);
+
+  // 多个线程同时使用，同一个key只有一份
+  JsonParse::set_key_pool(&pool);
+  string ndjson;
+  for (int i = 0; i < 1000; i++)
+    ndjson += "{\"k" + std::to_string(i % 50) + "\": " + std::to_string(i) + "}\n";
+  JsonBatch batch;
+  BOOST_CHECK(JsonParse::parse_many(ndjson, batch, 4) == 0);
+  BOOST_CHECK(pool.size() == 53);
+  BOOST_CHECK(batch[999].value.get_object_element_by("k49").get_int64() == 999);
+  JsonParse::set_key_pool(nullptr);
+}
+static void test_structural_index()
+{
+  JsonStructuralIndex index;
+  string str = "{\"a\": [1, \"b\\\"c\"]}";
+  BOOST_CHECK(index.build(str));
+  vector<uint32_t> expected = {0, 1, 4, 6, 7, 8, 10, 16, 17};
+  BOOST_CHECK(index.positions() == expected);
+  BOOST_CHECK(!index.build("[\"abc]"));
+
+  // 反斜杠和字符串跨过64字节的块边界，各个kernel的结果要一致
+  string json = "[";
+  for (int i = 0; i < 200; i++) {
+    if (i != 0) json += (i % 3 ? ", " : ",\n    ");
+    json += "\"" + string(i % 67, 'x') + string(i % 5, '\\') + (i % 5 % 2 ? "\"" : "") + "\"";
+  }
+  json += "]";
+  JsonStructuralIndex scalar;
+  BOOST_CHECK(scalar.build(json, JsonStructuralIndex::Kernel::SCALAR));
+  BOOST_CHECK(scalar.positions().size() == 1 + 200 * 2);
+  for (auto kernel : {JsonStructuralIndex::Kernel::SSE2, JsonStructuralIndex::Kernel::AVX2}) {
+    BOOST_CHECK(index.build(json, kernel));
+    BOOST_CHECK(index.positions() == scalar.positions());
+  }
+
+  // parse_parallel按索引切分顶层数组，结果和错误码与串行解析一样
+  JsonDocument doc;
+  BOOST_CHECK(JsonParse::parse_parallel(json, doc, 4) == JSON_PARSE_OK);
+  auto [json_value, json_err] = JsonParse::parse(json);
+  BOOST_CHECK(json_err == JSON_PARSE_OK);
+  for (size_t i = 0; i < 200; i++)
+    BOOST_CHECK(doc.root()[i].get_string() == json_value[i].get_string());
+  BOOST_CHECK(JsonParse::parse_parallel("[null ,  123   false]", doc, 4) == JSON_PARSE_ARRAY_MISS_COMMA);
+  BOOST_CHECK(JsonParse::parse_parallel("  null   x ", doc, 4) == JSON_PARSE_ROOT_NOT_SINGULAR);
+}
 static void test_parse()
 {
-#if 0
   test_parse_null();
   test_parse_bool();
   test_parse_number();
+  test_parse_integer();
   test_root_not_singular();
   test_invalid_value();
+  test_whitespace();
   test_parse_invalid_number();
   test_parse_string();
+  test_validate_utf8();
   test_parse_object_miss_key();
   test_parse_object_miss_member();
   test_parse_object_miss_colon();
   test_parse_object_miss_comma();
   test_parse_object_miss_bracket();
-#endif
-#if 0
-    test_parse_array();
+  test_parse_array();
   test_parse_object();
+  test_object_members();
+  test_object_lookup();
   test_array_error();
-#endif
+  test_parse_document();
+  test_parse_insitu();
+  test_parse_borrowed();
+  test_parse_on_demand();
+  test_parse_handler();
+  test_parse_stream();
+  test_parse_many();
+  test_parse_parallel();
+  test_json_parser();
+  test_max_depth();
+  test_key_pool();
+  test_parse_tape();
+  test_structural_index();
 }
+#define TEST_ROUNDTRIP(str) \
+    do { \
+        auto [json_value, json_err] = JsonParse::parse(str); \
+        BOOST_CHECK(json_err == JSON_PARSE_OK); \
+        BOOST_CHECK(JsonParse::stringfy(json_value) == (str)); \
+    } while (0)
+
 static void test_stringfy()
 {
+  TEST_ROUNDTRIP("null");
+  TEST_ROUNDTRIP("false");
+  TEST_ROUNDTRIP("true");
+  TEST_ROUNDTRIP("0");
+  TEST_ROUNDTRIP("-1");
+  TEST_ROUNDTRIP("1.5");
+  TEST_ROUNDTRIP("-1.5");
+  TEST_ROUNDTRIP("1e+20");
+  TEST_ROUNDTRIP("9223372036854775807");
+  TEST_ROUNDTRIP("-9223372036854775808");
+  TEST_ROUNDTRIP("18446744073709551615");
+  // 能读回同一个double的最短写法
+  TEST_ROUNDTRIP("0.1");
+  TEST_ROUNDTRIP("0.3");
+  TEST_ROUNDTRIP("1.0000000000000002");
+  TEST_ROUNDTRIP("0.0001");
+  TEST_ROUNDTRIP("1e-05");
+  TEST_ROUNDTRIP("5e-324");
+  TEST_ROUNDTRIP("2.2250738585072014e-308");
+  TEST_ROUNDTRIP("1.7976931348623157e+308");
+  TEST_ROUNDTRIP("-1.2345678901234568e+17");
+  // Grisu2在这些数上会多写几位，Grisu3判断不了的交给精确的回退
+  TEST_ROUNDTRIP("93442.6322");
+  TEST_ROUNDTRIP("56976.30293781");
+  TEST_ROUNDTRIP("9007199254740992");
+  {
+    // 2^53以上的整数也取最短的有效数字，按%.17g的排版补0
+    auto [value, err] = JsonParse::parse("[7.2057594037927952e16, 93442.63219999999]");
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    BOOST_CHECK(JsonParse::stringfy(value) == "[72057594037927950,93442.6322]");
+  }
+  {
+    auto [value, err] = JsonParse::parse("[0.10000000000000001, 1E2, 2.50, -0.0]");
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    BOOST_CHECK(JsonParse::stringfy(value) == "[0.1,100,2.5,-0]");
+  }
+  // 随机的double写出来再读回去，每一位都相同；有效数字和std::to_chars的最短输出一样
+  auto significant = [](const char *first, const char *last) {
+    string digits;
+    for (const char *p = first; p != last && *p != 'e'; p++)
+      if (*p >= '0' && *p <= '9') digits += *p;
+    digits.erase(0, std::min(digits.find_first_not_of('0'), digits.size() - 1));
+    while (digits.size() > 1 && digits.back() == '0') digits.pop_back();
+    return digits;
+  };
+  uint64_t seed = 42;
+  char buf[LEPT_DTOA_BUFFER_SIZE];
+  char shortest[32];
+  for (int i = 0; i < 100000; i++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    double number;
+    memcpy(&number, &seed, sizeof(number));
+    // 一半取常见量级的小数
+    if (i % 2) number = double(seed >> 11) / double(1ULL << 53) * 200000.0;
+    if (!std::isfinite(number)) continue;
+    char *last = lept_dtoa(number, buf);
+    string str(buf, last);
+    auto [value, err] = JsonParse::parse(str);
+    BOOST_CHECK(err == JSON_PARSE_OK);
+    BOOST_CHECK(value.get_number() == number);
+    auto res = std::to_chars(shortest, shortest + sizeof(shortest), number,
+                             std::chars_format::scientific);
+    BOOST_CHECK(significant(buf, last) == significant(shortest, res.ptr));
+  }
+  // 整数两位两位地查表
+  for (int64_t n : {INT64_MIN, INT64_MIN + 1, int64_t(-100), int64_t(-1), int64_t(0), int64_t(9),
+                    int64_t(10), int64_t(99), int64_t(100), int64_t(12345), INT64_MAX}) {
+    BOOST_CHECK(string(buf, lept_i64toa(n, buf)) == std::to_string(n));
+  }
+  for (uint64_t n = 1; n < UINT64_MAX / 10; n *= 10) {
+    BOOST_CHECK(string(buf, lept_u64toa(n - 1, buf)) == std::to_string(n - 1));
+    BOOST_CHECK(string(buf, lept_u64toa(n, buf)) == std::to_string(n));
+  }
+  BOOST_CHECK(string(buf, lept_u64toa(UINT64_MAX, buf)) == std::to_string(UINT64_MAX));
+  TEST_ROUNDTRIP("\"\"");
+  TEST_ROUNDTRIP("\"Hello\"");
+  TEST_ROUNDTRIP("\"Hello\\nWorld\"");
+  TEST_ROUNDTRIP("\"\\\" \\\\ / \\b \\f \\n \\r \\t\"");
+  TEST_ROUNDTRIP("\"Hello\\u0000World\\u001F\"");
+  TEST_ROUNDTRIP("\"\xE4\xBD\xA0\xE5\xA5\xBD\"");
+  TEST_ROUNDTRIP("[]");
+  TEST_ROUNDTRIP("[null,false,true,123,\"abc\",[1,2,3]]");
+  TEST_ROUNDTRIP("{}");
+  TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\","
+                 "\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
+  // 成员按原文顺序输出，重复的key也保留
+  TEST_ROUNDTRIP("{\"b\":1,\"a\":[{},[]],\"b\":{\"x\\ty\":[[{}]]}}");
+  // 空白去掉，\\u转义写成UTF-8
+  auto [value, err] = JsonParse::parse(" [ 1 , { \"a\" : \"\\u00e9\\/\" } ] ");
+  BOOST_CHECK(err == JSON_PARSE_OK);
+  BOOST_CHECK(JsonParse::stringfy(value) == "[1,{\"a\":\"\xC3\xA9/\"}]");
+
+  // 长字符串里的转义落在SIMD块的不同位置
+  string text(100, 'a');
+  for (size_t i = 0; i < 40; i++) {
+    string str = "[\"" + text.substr(0, i) + "\\n" + text + "\\u0001\\\"" + text.substr(0, i) + "\"]";
+    TEST_ROUNDTRIP(str);
+  }
+
+  // 同一个writer反复写，buffer不再增长
+  JsonWriter writer;
+  string json = "[";
+  for (int i = 0; i < 1000; i++) json += "{\"id\":" + std::to_string(i) + ",\"name\":\"n\\t\"},";
+  json += "1.25]";
+  JsonDocument doc;
+  BOOST_CHECK(JsonParse::parse(json, doc) == JSON_PARSE_OK);
+  BOOST_CHECK(writer.write(doc.root()) == json);
+  size_t capacity = writer.capacity();
+  for (int i = 0; i < 3; i++) BOOST_CHECK(writer.write(doc.root()) == json);
+  BOOST_CHECK(writer.capacity() == capacity);
+
+  // 调用者的buffer：放得下时直接写进去，放不下时返回需要的长度
+  vector<char> out(json.size());
+  BOOST_CHECK(writer.write(doc.root(), out.data(), out.size()) == json.size());
+  BOOST_CHECK(string(out.data(), out.size()) == json);
+  BOOST_CHECK(JsonParse::stringfy(doc.root(), out.data(), out.size()) == json.size());
+  BOOST_CHECK(string(out.data(), out.size()) == json);
+  for (size_t capacity : {size_t(0), size_t(1), size_t(100), json.size() - 1}) {
+    vector<char> small(capacity + 1, '#');
+    BOOST_CHECK(writer.write(doc.root(), small.data(), capacity) == json.size());
+    BOOST_CHECK(small[capacity] == '#');
+  }
+  // 先用空buffer问长度，再分配正好的大小写一遍
+  size_t needed = writer.write(doc.root(), nullptr, 0);
+  BOOST_CHECK(needed == json.size());
+  std::unique_ptr<char[]> sized(new char[needed]);
+  BOOST_CHECK(writer.write(doc.root(), sized.get(), needed) == needed);
+  BOOST_CHECK(string(sized.get(), needed) == json);
+  auto [one, one_err] = JsonParse::parse("1");
+  BOOST_CHECK(one_err == JSON_PARSE_OK);
+  BOOST_CHECK(JsonParse::stringfy(one, nullptr, 0) == 1);
+  char exact[16];
+  auto [short_value, short_err] = JsonParse::parse("[\"\\n\"]");
+  BOOST_CHECK(short_err == JSON_PARSE_OK);
+  BOOST_CHECK(writer.write(short_value, exact, 6) == 6);
+  BOOST_CHECK(string(exact, 6) == "[\"\\n\"]");
+
+  // 嵌套很深也不会爆栈，树放在JsonDocument里，析构时整块回收
+  JsonParser parser;
+  parser.set_max_depth(100000);
+  string deep = string(100000, '[') + string(100000, ']');
+  BOOST_CHECK(parser.parse(deep, doc) == JSON_PARSE_OK);
+  BOOST_CHECK(writer.write(doc.root()) == deep);
 }
 static void test_all() {
     test_parse();